@@ -265,6 +265,34 @@ public:
     };
 #define ISS_DRSP_INITIALIZER {false, false, 0}
 
+    /**
+     * Memory interface for loosely-timed runs, see executeQuantum().
+     *
+     * Each call performs the access immediately and fills the
+     * response, which must be valid. `offset' is the number of cycles
+     * the Iss is ahead of the platform time when issuing the access,
+     * targets needing accurate time (timers, ...) may use it.
+     *
+     * Return value is the access latency, in cycles. Setting `sync'
+     * makes the Iss return from executeQuantum() as soon as the
+     * access is completed, in order to let the platform synchronize.
+     */
+    class LtMemory
+    {
+    public:
+        virtual ~LtMemory() {}
+
+        virtual uint32_t fetch( const struct InstructionRequest &req,
+                                struct InstructionResponse &rsp,
+                                uint32_t offset,
+                                bool &sync ) = 0;
+
+        virtual uint32_t access( const struct DataRequest &req,
+                                 struct DataResponse &rsp,
+                                 uint32_t offset,
+                                 bool &sync ) = 0;
+    };
+
 protected:
 
     /**
@@ -314,6 +342,66 @@ public:
         const struct DataResponse &,
         uint32_t irq_bit_field ) = 0;
 
+    /**
+     * Loosely-timed execution: run ahead of the platform time for
+     * about `quantum' cycles, performing all the memory accesses
+     * through `mem', without any wrapper involved. Irq lines are
+     * considered stable for the whole quantum.
+     *
+     * Returns the number of cycles actually executed, i.e. the local
+     * time offset the platform has to catch up with. This is at least
+     * 1, less than quantum if an access asked for synchronization,
+     * and may exceed quantum by the latency of the last access.
+     *
+     * Default implementation drives getRequests() and
+     * executeNCycles(), an Iss may provide a faster one.
+     */
+    virtual uint32_t executeQuantum(
+        uint32_t quantum,
+        LtMemory &mem,
+        uint32_t irq_bit_field );
+
+    /**
+     * Returned by nextEventDelay() when the Iss is idle until an irq
+     * line changes.
+     */
+    static const uint32_t NO_EVENT = (uint32_t)-1;
+
+    /**
+     * Number of cycles during which the Iss will do nothing but wait,
+     * knowing the irq lines will stay at irq_bit_field: no request
+     * will change and no internal event will happen. 0 means the Iss
+     * is active, NO_EVENT means it only waits for irq lines to
+     * change.
+     *
+     * Wrappers may use this to avoid clocking idle processors. Skipped
+     * cycles must still be accounted for, with a single
+     * executeNCycles() call for all of them.
+     */
+    virtual uint32_t nextEventDelay( uint32_t irq_bit_field ) const
+    {
+        return 0;
+    }
+
+    /**
+     * Checkpointing, optional. Save the complete Iss state to a
+     * versioned binary blob, to be restored by stateRestore() on an
+     * Iss of the same type. Platform-provided settings (cache infos,
+     * DMI grants, ...) are not part of the state.
+     *
+     * Both return false if not supported or on error. A failed
+     * restore leaves the Iss state untouched.
+     */
+    virtual bool stateSave( std::ostream &o ) const
+    {
+        return false;
+    }
+
+    virtual bool stateRestore( std::istream &i )
+    {
+        return false;
+    }
+
     // CDB method's
 #ifdef CDB_COMPONENT_IF_H
     virtual const char* local_GetModel() = 0;
@@ -343,6 +431,56 @@ public:
      */
     virtual void setDCacheInfo( size_t line_size, size_t assoc, size_t n_lines ) {}
 
+    /*
+     * Direct memory interface (DMI) API, optional
+     */
+
+    /** Permissions of a DMI grant */
+    enum DmiAccess {
+        DMI_READ = 1,
+        DMI_WRITE = 2,
+        DMI_READ_WRITE = 3,
+    };
+
+    /**
+     * Grant the Iss direct access to the [base, base+size) address
+     * range, backed by host memory at host_ptr. The byte at address
+     * `a' is host_ptr[a-base], whatever the Iss endianness.
+     *
+     * Instruction fetches (DMI_READ) and plain DATA_READ/DATA_WRITE
+     * accesses to words entirely inside a granted range are then
+     * performed by the Iss itself: they do not show up in
+     * getRequests() anymore, and no response is expected for them in
+     * executeNCycles(). All other accesses (LL/SC, extended accesses,
+     * accesses outside grants) still go through the wrapper.
+     *
+     * As such accesses bypass the caches, the grantor must only grant
+     * ranges where this is coherent, and revoke grants when it is not
+     * anymore (e.g. on XTN_DCACHE_INVAL, or on a mapping change in the
+     * interconnect).
+     *
+     * Returns whether the grant was accepted. Iss not supporting DMI
+     * always refuse.
+     */
+    virtual bool dmiGrant( addr_t base, size_t size, uint8_t *host_ptr, int access )
+    {
+        return false;
+    }
+
+    /**
+     * Revoke all grants intersecting [base, base+size). Takes effect
+     * for the next access.
+     */
+    virtual void dmiRevoke( addr_t base, size_t size ) {}
+
+    /**
+     * Tell the Iss [base, base+size) was just written by someone else
+     * (another core, a DMA, a device updating its registers), from
+     * the thread running the Iss, between two executeNCycles() calls.
+     * Optional, only needed by Iss asking for it.
+     */
+    virtual void snoopWrite( addr_t base, size_t size ) {}
+
     /*
      * Debugger API
      */
@@ -0,0 +1,197 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#ifndef _SOCLIB_ISS2_PARALLEL_H_
+#define _SOCLIB_ISS2_PARALLEL_H_
+
+#include "iss2.h"
+
+#include <vector>
+#include <pthread.h>
+
+namespace soclib { namespace common {
+
+/**
+ * Runs several Iss on as many host threads, in loosely-timed mode
+ * (see Iss2::executeQuantum()).
+ *
+ * Cores run freely in parallel within a quantum, and all meet at the
+ * quantum end. Accesses to shared data are performed one at a time,
+ * in the order of their (cycle, core index) key: an Iss issuing one
+ * waits until every other core is either done with the quantum, or
+ * waiting for a shared access with a greater key. Results only
+ * depend on the quantum, not on host thread scheduling, as long as
+ * the Iss themselves are deterministic.
+ *
+ * Shared writes are reported to the other cores with
+ * Iss2::snoopWrite(). They are queued, and each core applies its
+ * queue from its own thread, once done with its next shared access
+ * or at the start of the next quantum, whichever comes first. A core
+ * parked polling a shared word wakes up at the latest at the start
+ * of the next quantum.
+ *
+ * Memory must be thread-safe for the accesses it tells private, and
+ * for all instruction fetches. Accesses through DMI grants are not
+ * seen, shared memory must not be granted.
+ */
+class Iss2ParallelDriver
+{
+public:
+    /**
+     * Platform memory, see Iss2::LtMemory. `core' is the index of
+     * the issuing core, in addIss() order, and `offset' counts cycles
+     * from the start of the current quantum.
+     */
+    class Memory
+    {
+    public:
+        virtual ~Memory() {}
+
+        virtual uint32_t fetch( size_t core,
+                                const struct Iss2::InstructionRequest &req,
+                                struct Iss2::InstructionResponse &rsp,
+                                uint32_t offset,
+                                bool &sync ) = 0;
+
+        virtual uint32_t access( size_t core,
+                                 const struct Iss2::DataRequest &req,
+                                 struct Iss2::DataResponse &rsp,
+                                 uint32_t offset,
+                                 bool &sync ) = 0;
+
+        /**
+         * Whether `req' may conflict with accesses of other cores,
+         * LL/SC and extended accesses typically are.
+         */
+        virtual bool isShared( size_t core,
+                               const struct Iss2::DataRequest &req ) = 0;
+    };
+
+    Iss2ParallelDriver( Memory &mem, uint32_t quantum );
+    virtual ~Iss2ParallelDriver();
+
+    /**
+     * Cores must all be added before the first run().
+     */
+    void addIss( Iss2 *iss );
+
+    /**
+     * Irq lines of a core, taken into account from the next quantum.
+     */
+    void setIrq( size_t core, uint32_t irq_bit_field );
+
+    /**
+     * Runs `nquanta' quanta, returns the current time in cycles.
+     */
+    uint64_t run( uint64_t nquanta );
+
+    inline uint64_t time() const
+    {
+        return m_time;
+    }
+
+protected:
+    /**
+     * Called between quanta, from the thread calling run(), while no
+     * core runs. Platforms may update irq lines from here.
+     */
+    virtual void quantumEnd( uint64_t time ) {}
+
+private:
+    enum CoreState {
+        RUNNING,
+        WAITING,
+        DONE,
+    };
+
+    class Core
+        : public Iss2::LtMemory
+    {
+    public:
+        Iss2ParallelDriver *m_driver;
+        size_t m_index;
+        Iss2 *m_iss;
+        pthread_t m_thread;
+        uint32_t m_irq;
+        // Local time at the start of the current executeQuantum()
+        uint64_t m_time;
+        enum CoreState m_state;
+        // Time of the awaited shared access
+        uint64_t m_key;
+        // Words written by other cores, not yet told to m_iss.
+        // Protected by m_lock.
+        std::vector<Iss2::addr_t> m_snoops;
+
+        uint32_t fetch( const struct Iss2::InstructionRequest &req,
+                        struct Iss2::InstructionResponse &rsp,
+                        uint32_t offset,
+                        bool &sync );
+        uint32_t access( const struct Iss2::DataRequest &req,
+                         struct Iss2::DataResponse &rsp,
+                         uint32_t offset,
+                         bool &sync );
+    };
+
+    Memory &m_mem;
+    const uint32_t m_quantum;
+    uint64_t m_time;
+    std::vector<Core*> m_cores;
+    bool m_started;
+    bool m_stop;
+
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_turn;
+    pthread_barrier_t m_start;
+    pthread_barrier_t m_end;
+
+    void start();
+    bool mayAccess( const Core *core ) const;
+    uint32_t sharedAccess( Core *core,
+                           const struct Iss2::DataRequest &req,
+                           struct Iss2::DataResponse &rsp,
+                           uint32_t offset,
+                           bool &sync );
+    void applySnoops( Core *core, std::vector<Iss2::addr_t> &snoops );
+    void runQuantum( Core *core );
+    static void *coreMain( void *core );
+};
+
+}}
+
+#endif /* _SOCLIB_ISS2_PARALLEL_H_ */
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,350 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#ifndef _SOCLIB_ISS2_TRACE_H_
+#define _SOCLIB_ISS2_TRACE_H_
+
+#include "iss2.h"
+
+#include <pthread.h>
+
+namespace soclib { namespace common {
+
+/**
+ * Compact binary trace of retired instructions and their data
+ * accesses, as produced by an Iss, see Mips32Iss::setTrace().
+ *
+ * The stream starts with the "I2TR" magic and a version byte, then
+ * holds one record per retired instruction:
+ *
+ *  - flags byte:
+ *    - bit 0 (TRACE_JUMP): pc is not the previous one + 4, and follows
+ *      as a zigzag varint, relative to previous pc + 4,
+ *    - bit 1 (TRACE_INS): instruction word follows, 4 bytes, little
+ *      endian. Otherwise it is the last one recorded in the 1024-entry
+ *      table indexed by (pc >> 2) % 1024, initially all zero,
+ *    - bit 2 (TRACE_DATA): a data access follows,
+ *    - bit 3 (TRACE_ERROR): data access got a bus error,
+ *    - bits 4-5: ExecMode of the instruction and its access,
+ *    - bit 6 (TRACE_PAIR): the record only holds the second word of
+ *      a 64-bit data access of the previous record's instruction,
+ *      without pc nor instruction word. TRACE_DATA is set;
+ *  - if TRACE_DATA:
+ *    - one byte, DataOperationType in bits 0-3, byte enable in bits
+ *      4-7,
+ *    - address as a zigzag varint, relative to previous data address,
+ *    - wdata as a varint for DATA_WRITE, DATA_SC and XTN_WRITE,
+ *    - rdata as a varint for DATA_READ, DATA_LL, DATA_SC and XTN_READ,
+ *      unless TRACE_ERROR.
+ *
+ * Varints are little endian base-128, 7 bits per byte, MSB set on all
+ * bytes but the last.
+ */
+class Iss2Trace
+{
+public:
+    typedef Iss2::addr_t addr_t;
+    typedef Iss2::data_t data_t;
+
+    enum {
+        TRACE_JUMP = 0x1,
+        TRACE_INS = 0x2,
+        TRACE_DATA = 0x4,
+        TRACE_ERROR = 0x8,
+        TRACE_MODE_SHIFT = 4,
+        TRACE_PAIR = 0x40,
+
+        TRACE_VERSION = 2,
+        TRACE_INS_TABLE_SIZE = 1024,
+    };
+
+protected:
+    static const char s_magic[4];
+
+    static inline uint32_t zigzag( uint32_t v )
+    {
+        return (v << 1) ^ (uint32_t)((int32_t)v >> 31);
+    }
+
+    static inline uint32_t unzigzag( uint32_t v )
+    {
+        return (v >> 1) ^ -(v & 1);
+    }
+
+    static inline bool hasWdata( enum Iss2::DataOperationType type )
+    {
+        return type == Iss2::DATA_WRITE || type == Iss2::DATA_SC
+            || type == Iss2::XTN_WRITE;
+    }
+
+    static inline bool hasRdata( enum Iss2::DataOperationType type )
+    {
+        return type != Iss2::DATA_WRITE && type != Iss2::XTN_WRITE;
+    }
+};
+
+/**
+ * Trace producer.
+ *
+ * Records are encoded by the simulation thread into a lock-free
+ * single-producer single-consumer ring, a background thread writes
+ * the ring to the output stream. The simulation only waits when the
+ * ring is full.
+ */
+class Iss2TraceWriter
+    : public Iss2Trace
+{
+public:
+    /**
+     * `o' must not be used by anybody else until the writer is
+     * destroyed. `ring_size' is rounded up to a power of two.
+     */
+    Iss2TraceWriter( std::ostream &o, size_t ring_size = 1 << 22 );
+
+    /**
+     * Writes the pending records, then stops the background thread.
+     */
+    ~Iss2TraceWriter();
+
+    /**
+     * Records a retired instruction without data access.
+     */
+    inline void retire( addr_t pc, uint32_t ins, enum Iss2::ExecMode mode )
+    {
+        reserve();
+        header( pc, ins, mode, 0 );
+        commit();
+    }
+
+    /**
+     * Records a retired instruction issuing `req'. The record is
+     * only completed by the matching complete().
+     */
+    inline void retireAccess( addr_t pc, uint32_t ins, enum Iss2::ExecMode mode,
+                              const struct Iss2::DataRequest &req )
+    {
+        reserve();
+        m_pending_flags = m_head;
+        header( pc, ins, mode, TRACE_DATA );
+        access( req );
+    }
+
+    /**
+     * Records `req', second word of the 64-bit access of the last
+     * retired instruction, once the first one is complete(). The
+     * record is only completed by the matching complete().
+     */
+    inline void retirePair( const struct Iss2::DataRequest &req )
+    {
+        reserve();
+        m_pending_flags = m_head;
+        put8( TRACE_DATA | TRACE_PAIR | (req.mode << TRACE_MODE_SHIFT) );
+        m_records++;
+        access( req );
+    }
+
+    inline bool pending() const
+    {
+        return m_pending;
+    }
+
+    inline void complete( const struct Iss2::DataResponse &rsp )
+    {
+        m_pending = false;
+        if ( rsp.error ) {
+            m_ring[m_pending_flags & m_mask] |= TRACE_ERROR;
+        } else if ( hasRdata( m_pending_type ) ) {
+            putVarint( rsp.rdata );
+        }
+        commit();
+    }
+
+    /**
+     * Waits until everything recorded so far is written to the
+     * stream.
+     */
+    void flush();
+
+    inline uint64_t records() const
+    {
+        return m_records;
+    }
+
+private:
+    enum {
+        // Largest record: flags, pc, ins, type, addr, wdata, rdata
+        MAX_RECORD = 1 + 5 + 4 + 1 + 5 + 5 + 5,
+    };
+
+    std::ostream &m_o;
+    uint8_t *m_ring;
+    size_t m_mask;
+
+    // Producer side. m_head is published once a record is complete.
+    size_t m_head;
+    size_t m_published;
+    size_t m_tail_cache;
+    addr_t m_next_pc;
+    addr_t m_last_addr;
+    uint32_t m_ins_table[TRACE_INS_TABLE_SIZE];
+    bool m_pending;
+    size_t m_pending_flags;
+    enum Iss2::DataOperationType m_pending_type;
+    uint64_t m_records;
+
+    // Consumer side
+    size_t m_tail;
+    bool m_stop;
+    pthread_t m_thread;
+
+    inline void put8( uint8_t v )
+    {
+        m_ring[m_head++ & m_mask] = v;
+    }
+
+    inline void putVarint( uint32_t v )
+    {
+        while ( v >= 0x80 ) {
+            put8( v | 0x80 );
+            v >>= 7;
+        }
+        put8( v );
+    }
+
+    inline void access( const struct Iss2::DataRequest &req )
+    {
+        put8( req.type | (req.be << 4) );
+        putVarint( zigzag( req.addr - m_last_addr ) );
+        m_last_addr = req.addr;
+        if ( hasWdata( req.type ) )
+            putVarint( req.wdata );
+        m_pending_type = req.type;
+        m_pending = true;
+    }
+
+    // Flags byte is only known at the end, it is patched in place
+    inline void header( addr_t pc, uint32_t ins, enum Iss2::ExecMode mode,
+                        uint8_t flags )
+    {
+        size_t at = m_head++;
+        flags |= mode << TRACE_MODE_SHIFT;
+        if ( pc != m_next_pc ) {
+            flags |= TRACE_JUMP;
+            putVarint( zigzag( pc - m_next_pc ) );
+        }
+        m_next_pc = pc + 4;
+        uint32_t &last = m_ins_table[(pc >> 2) % TRACE_INS_TABLE_SIZE];
+        if ( last != ins ) {
+            flags |= TRACE_INS;
+            last = ins;
+            for ( size_t i = 0; i < 4; ++i )
+                put8( ins >> (8*i) );
+        }
+        m_ring[at & m_mask] = flags;
+        m_records++;
+    }
+
+    inline void reserve()
+    {
+        if ( m_head + MAX_RECORD - m_tail_cache > m_mask + 1 )
+            waitSpace();
+    }
+
+    inline void commit()
+    {
+        __atomic_store_n( &m_published, m_head, __ATOMIC_RELEASE );
+    }
+
+    void waitSpace();
+    static void *writerMain( void *self );
+    void writerLoop();
+};
+
+/**
+ * Trace consumer, decoding records back.
+ */
+class Iss2TraceReader
+    : public Iss2Trace
+{
+public:
+    struct Record {
+        addr_t pc;
+        uint32_t ins;
+        enum Iss2::ExecMode mode;
+        // req.valid tells whether there is a data access
+        struct Iss2::DataRequest req;
+        bool error;
+        data_t rdata;
+        // Second word of the previous record's access, same pc and ins
+        bool pair;
+    };
+
+    /**
+     * Checks the stream header, see good().
+     */
+    Iss2TraceReader( std::istream &i );
+
+    /**
+     * Stream header is valid, and no decoding error happened so far.
+     */
+    inline bool good() const
+    {
+        return m_good;
+    }
+
+    /**
+     * Decodes the next record, returns false at the end of the trace
+     * or on a truncated record.
+     */
+    bool next( Record &r );
+
+private:
+    std::streambuf *m_buf;
+    bool m_good;
+    addr_t m_next_pc;
+    addr_t m_last_addr;
+    uint32_t m_ins_table[TRACE_INS_TABLE_SIZE];
+
+    bool get8( uint8_t &v );
+    bool getVarint( uint32_t &v );
+};
+
+}}
+
+#endif /* _SOCLIB_ISS2_TRACE_H_ */
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
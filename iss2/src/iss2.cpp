@@ -116,6 +116,47 @@ void Iss2::DataResponse::print( std::ostream &o ) const
       << ">";
 }
 
+uint32_t Iss2::executeQuantum(
+    uint32_t quantum,
+    LtMemory &mem,
+    uint32_t irq_bit_field )
+{
+    const struct InstructionResponse no_irsp = ISS_IRSP_INITIALIZER;
+    const struct DataResponse no_drsp = ISS_DRSP_INITIALIZER;
+    uint32_t offset = 0;
+    bool sync = false;
+
+    while ( offset < quantum && ! sync ) {
+        struct InstructionRequest ireq = ISS_IREQ_INITIALIZER;
+        struct DataRequest dreq = ISS_DREQ_INITIALIZER;
+        struct InstructionResponse irsp = ISS_IRSP_INITIALIZER;
+        struct DataResponse drsp = ISS_DRSP_INITIALIZER;
+        uint32_t latency = 0;
+
+        getRequests( ireq, dreq );
+        if ( ireq.valid )
+            latency = mem.fetch( ireq, irsp, offset, sync );
+        if ( dreq.valid ) {
+            uint32_t data_latency = mem.access( dreq, drsp, offset, sync );
+            if ( data_latency > latency )
+                latency = data_latency;
+        }
+
+        // Accesses are already done, responses must be delivered even
+        // if this overruns the quantum.
+        while ( latency ) {
+            uint32_t n = executeNCycles( latency, no_irsp, no_drsp, irq_bit_field );
+            latency -= n;
+            offset += n;
+        }
+
+        // On sync, only deliver the responses
+        offset += executeNCycles( offset < quantum && ! sync ? quantum - offset : 1,
+                                  irsp, drsp, irq_bit_field );
+    }
+    return offset;
+}
+
 
 }}
 
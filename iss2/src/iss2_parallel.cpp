@@ -0,0 +1,231 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "iss2_parallel.h"
+
+#include <cassert>
+
+namespace soclib { namespace common {
+
+Iss2ParallelDriver::Iss2ParallelDriver( Memory &mem, uint32_t quantum )
+    : m_mem(mem),
+      m_quantum(quantum),
+      m_time(0),
+      m_started(false),
+      m_stop(false)
+{
+    assert( quantum > 0 );
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_turn, NULL);
+}
+
+Iss2ParallelDriver::~Iss2ParallelDriver()
+{
+    if ( m_started ) {
+        m_stop = true;
+        pthread_barrier_wait(&m_start);
+        for ( size_t i = 0; i < m_cores.size(); ++i )
+            pthread_join(m_cores[i]->m_thread, NULL);
+        pthread_barrier_destroy(&m_start);
+        pthread_barrier_destroy(&m_end);
+    }
+    for ( size_t i = 0; i < m_cores.size(); ++i )
+        delete m_cores[i];
+    pthread_cond_destroy(&m_turn);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void Iss2ParallelDriver::addIss( Iss2 *iss )
+{
+    assert( ! m_started && "Cores must be added before running" );
+    Core *core = new Core;
+    core->m_driver = this;
+    core->m_index = m_cores.size();
+    core->m_iss = iss;
+    core->m_irq = 0;
+    core->m_time = m_time;
+    core->m_state = DONE;
+    core->m_key = 0;
+    m_cores.push_back(core);
+}
+
+void Iss2ParallelDriver::setIrq( size_t core, uint32_t irq_bit_field )
+{
+    m_cores[core]->m_irq = irq_bit_field;
+}
+
+void Iss2ParallelDriver::start()
+{
+    // Cores plus the thread calling run()
+    pthread_barrier_init(&m_start, NULL, m_cores.size() + 1);
+    pthread_barrier_init(&m_end, NULL, m_cores.size() + 1);
+    for ( size_t i = 0; i < m_cores.size(); ++i ) {
+        int err = pthread_create(&m_cores[i]->m_thread, NULL, coreMain, m_cores[i]);
+        assert( err == 0 && "Unable to start core thread" );
+        (void)err;
+    }
+    m_started = true;
+}
+
+uint64_t Iss2ParallelDriver::run( uint64_t nquanta )
+{
+    if ( ! m_started )
+        start();
+
+    for ( uint64_t q = 0; q < nquanta; ++q ) {
+        for ( size_t i = 0; i < m_cores.size(); ++i )
+            m_cores[i]->m_state = RUNNING;
+        pthread_barrier_wait(&m_start);
+        pthread_barrier_wait(&m_end);
+        m_time += m_quantum;
+        quantumEnd( m_time );
+    }
+    return m_time;
+}
+
+void *Iss2ParallelDriver::coreMain( void *arg )
+{
+    Core *core = static_cast<Core*>(arg);
+    Iss2ParallelDriver *driver = core->m_driver;
+
+    for (;;) {
+        pthread_barrier_wait(&driver->m_start);
+        if ( driver->m_stop )
+            return NULL;
+        driver->runQuantum( core );
+        pthread_barrier_wait(&driver->m_end);
+    }
+}
+
+// Called from the thread of `core', out of m_lock, with the queue
+// taken under it.
+void Iss2ParallelDriver::applySnoops( Core *core, std::vector<Iss2::addr_t> &snoops )
+{
+    for ( size_t i = 0; i < snoops.size(); ++i )
+        core->m_iss->snoopWrite( snoops[i], 4 );
+    snoops.clear();
+}
+
+void Iss2ParallelDriver::runQuantum( Core *core )
+{
+    std::vector<Iss2::addr_t> snoops;
+
+    pthread_mutex_lock(&m_lock);
+    snoops.swap( core->m_snoops );
+    pthread_mutex_unlock(&m_lock);
+    applySnoops( core, snoops );
+
+    // A core overrunning a quantum starts late in the next one
+    uint64_t end = m_time + m_quantum;
+    while ( core->m_time < end )
+        core->m_time += core->m_iss->executeQuantum(
+            end - core->m_time, *core, core->m_irq );
+
+    pthread_mutex_lock(&m_lock);
+    core->m_state = DONE;
+    pthread_cond_broadcast(&m_turn);
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool Iss2ParallelDriver::mayAccess( const Core *core ) const
+{
+    for ( size_t i = 0; i < m_cores.size(); ++i ) {
+        const Core *other = m_cores[i];
+        if ( other == core || other->m_state == DONE )
+            continue;
+        if ( other->m_state == RUNNING )
+            return false;
+        if ( other->m_key < core->m_key
+             || (other->m_key == core->m_key && other->m_index < core->m_index) )
+            return false;
+    }
+    return true;
+}
+
+uint32_t Iss2ParallelDriver::sharedAccess( Core *core,
+                                           const struct Iss2::DataRequest &req,
+                                           struct Iss2::DataResponse &rsp,
+                                           uint32_t offset,
+                                           bool &sync )
+{
+    pthread_mutex_lock(&m_lock);
+    core->m_state = WAITING;
+    core->m_key = m_time + offset;
+    pthread_cond_broadcast(&m_turn);
+    while ( ! mayAccess( core ) )
+        pthread_cond_wait(&m_turn, &m_lock);
+    uint32_t latency = m_mem.access( core->m_index, req, rsp, offset, sync );
+    // Other cores are told from their own thread
+    if ( (req.type == Iss2::DATA_WRITE || req.type == Iss2::DATA_SC)
+         && ! rsp.error )
+        for ( size_t i = 0; i < m_cores.size(); ++i )
+            if ( m_cores[i] != core )
+                m_cores[i]->m_snoops.push_back( req.addr );
+    core->m_state = RUNNING;
+    std::vector<Iss2::addr_t> snoops;
+    snoops.swap( core->m_snoops );
+    pthread_mutex_unlock(&m_lock);
+
+    applySnoops( core, snoops );
+    return latency;
+}
+
+// Offsets from the Iss are relative to the start of its
+// executeQuantum() call
+uint32_t Iss2ParallelDriver::Core::fetch( const struct Iss2::InstructionRequest &req,
+                                          struct Iss2::InstructionResponse &rsp,
+                                          uint32_t offset,
+                                          bool &sync )
+{
+    offset += m_time - m_driver->m_time;
+    return m_driver->m_mem.fetch( m_index, req, rsp, offset, sync );
+}
+
+uint32_t Iss2ParallelDriver::Core::access( const struct Iss2::DataRequest &req,
+                                           struct Iss2::DataResponse &rsp,
+                                           uint32_t offset,
+                                           bool &sync )
+{
+    offset += m_time - m_driver->m_time;
+    if ( m_driver->m_mem.isShared( m_index, req ) )
+        return m_driver->sharedAccess( this, req, rsp, offset, sync );
+    return m_driver->m_mem.access( m_index, req, rsp, offset, sync );
+}
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,240 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "iss2_trace.h"
+
+#include <cassert>
+#include <cstring>
+#include <sched.h>
+#include <time.h>
+
+namespace soclib { namespace common {
+
+const char Iss2Trace::s_magic[4] = { 'I', '2', 'T', 'R' };
+
+Iss2TraceWriter::Iss2TraceWriter( std::ostream &o, size_t ring_size )
+    : m_o(o),
+      m_head(0),
+      m_published(0),
+      m_tail_cache(0),
+      m_next_pc(0),
+      m_last_addr(0),
+      m_pending(false),
+      m_records(0),
+      m_tail(0),
+      m_stop(false)
+{
+    size_t size = 1;
+    while ( size < ring_size || size < 2 * MAX_RECORD )
+        size <<= 1;
+    m_ring = new uint8_t[size];
+    m_mask = size - 1;
+    std::memset(m_ins_table, 0, sizeof(m_ins_table));
+
+    m_o.write(s_magic, sizeof(s_magic));
+    m_o.put(TRACE_VERSION);
+
+    int err = pthread_create(&m_thread, NULL, writerMain, this);
+    assert( err == 0 && "Unable to start trace writer thread" );
+    (void)err;
+}
+
+Iss2TraceWriter::~Iss2TraceWriter()
+{
+    // An access still pending is not part of the trace
+    __atomic_store_n( &m_stop, true, __ATOMIC_RELEASE );
+    pthread_join(m_thread, NULL);
+    m_o.flush();
+    delete [] m_ring;
+}
+
+void Iss2TraceWriter::flush()
+{
+    while ( __atomic_load_n( &m_tail, __ATOMIC_ACQUIRE ) != m_published )
+        sched_yield();
+    m_o.flush();
+}
+
+void Iss2TraceWriter::waitSpace()
+{
+    for (;;) {
+        m_tail_cache = __atomic_load_n( &m_tail, __ATOMIC_ACQUIRE );
+        if ( m_head + MAX_RECORD - m_tail_cache <= m_mask + 1 )
+            return;
+        sched_yield();
+    }
+}
+
+void *Iss2TraceWriter::writerMain( void *self )
+{
+    static_cast<Iss2TraceWriter*>(self)->writerLoop();
+    return NULL;
+}
+
+void Iss2TraceWriter::writerLoop()
+{
+    size_t tail = m_tail;
+
+    for (;;) {
+        // Stop flag must be read before the last records
+        bool stop = __atomic_load_n( &m_stop, __ATOMIC_ACQUIRE );
+        size_t head = __atomic_load_n( &m_published, __ATOMIC_ACQUIRE );
+
+        if ( head == tail ) {
+            if ( stop )
+                return;
+            struct timespec ts = { 0, 100000 };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        // At most two chunks, around the end of the ring
+        while ( tail != head ) {
+            size_t from = tail & m_mask;
+            size_t len = head - tail;
+            if ( len > m_mask + 1 - from )
+                len = m_mask + 1 - from;
+            m_o.write((const char*)m_ring + from, len);
+            tail += len;
+        }
+        __atomic_store_n( &m_tail, tail, __ATOMIC_RELEASE );
+    }
+}
+
+Iss2TraceReader::Iss2TraceReader( std::istream &i )
+    : m_buf(i.rdbuf()),
+      m_good(true),
+      m_next_pc(0),
+      m_last_addr(0)
+{
+    std::memset(m_ins_table, 0, sizeof(m_ins_table));
+
+    for ( size_t n = 0; n < sizeof(s_magic); ++n ) {
+        uint8_t c;
+        if ( ! get8(c) || c != (uint8_t)s_magic[n] )
+            m_good = false;
+    }
+    uint8_t version;
+    if ( ! get8(version) || version != TRACE_VERSION )
+        m_good = false;
+}
+
+bool Iss2TraceReader::get8( uint8_t &v )
+{
+    int c = m_buf->sbumpc();
+    if ( c == std::streambuf::traits_type::eof() )
+        return false;
+    v = c;
+    return true;
+}
+
+bool Iss2TraceReader::getVarint( uint32_t &v )
+{
+    v = 0;
+    for ( size_t shift = 0; shift < 35; shift += 7 ) {
+        uint8_t c;
+        if ( ! get8(c) )
+            return false;
+        v |= (uint32_t)(c & 0x7f) << shift;
+        if ( ! (c & 0x80) )
+            return true;
+    }
+    return false;
+}
+
+bool Iss2TraceReader::next( Record &r )
+{
+    uint8_t flags;
+
+    if ( ! m_good || ! get8(flags) )
+        return false;
+
+    // From here, running out of data is an error
+    m_good = false;
+
+    r.pair = flags & TRACE_PAIR;
+    r.pc = m_next_pc;
+    if ( r.pair ) {
+        r.pc -= 4;
+    } else if ( flags & TRACE_JUMP ) {
+        uint32_t delta;
+        if ( ! getVarint(delta) )
+            return false;
+        r.pc += unzigzag(delta);
+    }
+    m_next_pc = r.pc + 4;
+
+    uint32_t &ins = m_ins_table[(r.pc >> 2) % TRACE_INS_TABLE_SIZE];
+    if ( flags & TRACE_INS ) {
+        ins = 0;
+        for ( size_t i = 0; i < 4; ++i ) {
+            uint8_t c;
+            if ( ! get8(c) )
+                return false;
+            ins |= (uint32_t)c << (8*i);
+        }
+    }
+    r.ins = ins;
+    r.mode = (enum Iss2::ExecMode)((flags >> TRACE_MODE_SHIFT) & 0x3);
+
+    r.req.valid = flags & TRACE_DATA;
+    r.error = flags & TRACE_ERROR;
+    r.rdata = 0;
+    if ( r.req.valid ) {
+        uint8_t type_be;
+        uint32_t delta;
+        if ( ! get8(type_be) || ! getVarint(delta) )
+            return false;
+        r.req.type = (enum Iss2::DataOperationType)(type_be & 0xf);
+        r.req.be = type_be >> 4;
+        r.req.addr = m_last_addr + unzigzag(delta);
+        r.req.mode = r.mode;
+        m_last_addr = r.req.addr;
+        r.req.wdata = 0;
+        if ( hasWdata( r.req.type ) && ! getVarint(r.req.wdata) )
+            return false;
+        if ( ! r.error && hasRdata( r.req.type ) && ! getVarint(r.rdata) )
+            return false;
+    }
+
+    m_good = true;
+    return true;
+}
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,559 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+// Raw Mips32Iss throughput benchmark, without SystemC nor any cache
+// wrapper: the core is driven by a flat host memory answering all
+// requests in zero wait states.
+//
+// Build against the mips32_sls and iss2_sls sources only, e.g.:
+//
+//   g++ -O2 -I<soclib>/soclib/lib/include -Iiss2/include
+//       -Imips32/include mips32/bench/mips32_bench.cpp mips32/src/*.cpp
+//       iss2/src/*.cpp -o mips32_bench -lpthread
+//
+// (one command line).
+//
+// Usage: mips32_bench [-m mode]... [-s scale] [-e] [-o] [kernel]...
+//
+// Runs each kernel in each mode, and reports host nanoseconds per
+// retired instruction. Modes are:
+//  - wrapper: one executeNCycles() call per cycle, all fetches and
+//    data accesses through getRequests(), as a cache wrapper does,
+//  - dmi: memory granted to the core, block execution,
+//  - jit: same as dmi, with translation,
+//  - quantum: executeQuantum() over the flat memory, without DMI, so
+//    that every access goes through Iss2::LtMemory.
+// With -o, also runs one loop per instruction kind and reports its
+// cost relative to nop.
+
+#include "mips32_bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace mips32_bench;
+
+namespace {
+
+// Kernels leave their checksum in v0, then jump to the common exit.
+// s7 holds the timer period of the interrupt handler, s6 counts the
+// interrupts.
+
+void kernelExit( Assembler &a )
+{
+    a.li(T0, KSEG1 | EXIT_ADDR);
+    a.sw(ZERO, 0, T0);
+    Assembler::label_t self = a.label();
+    a.bind(self);
+    a.b(self);
+    a.nop();
+}
+
+// Timer interrupts rearm the timer, any other exception ends the run
+// with an error.
+void exceptionVector( Assembler &a )
+{
+    Assembler::label_t fault = a.label();
+
+    a.org(VECTOR_OFFSET);
+    a.mfc0(K0, CP0_CAUSE);
+    a.andi(K1, K0, 0x7c);
+    a.bne(K1, ZERO, fault);
+    a.nop();
+    a.mfc0(K0, CP0_COUNT);
+    a.addu(K0, K0, S7);
+    a.mtc0(K0, CP0_COMPARE);
+    a.addiu(S6, S6, 1);
+    a.eret();
+    a.bind(fault);
+    a.li(K0, KSEG1 | EXIT_ADDR);
+    a.li(K1, 1);
+    a.sw(K1, 0, K0);
+    a.b(fault);
+    a.nop();
+}
+
+// Loop counter in s3, decremented at the end of each repetition
+void repeatEnd( Assembler &a, Assembler::label_t rep )
+{
+    a.addiu(S3, S3, -1);
+    a.bne(S3, ZERO, rep);
+    a.nop();
+}
+
+// CoreMark-like: 8x8 integer matrix product
+void matrixKernel( Assembler &a, uint32_t scale )
+{
+    Assembler::label_t init = a.label(), rep = a.label();
+    Assembler::label_t iloop = a.label(), jloop = a.label();
+
+    a.li(S0, KSEG0 | 0x1000);
+    a.li(S1, KSEG0 | 0x1100);
+    a.li(S2, KSEG0 | 0x1200);
+
+    // A[i] = 3i+1, B[i] = i^0x55
+    a.li(T0, 0);
+    a.li(T5, 64);
+    a.bind(init);
+    a.sll(T1, T0, 1);
+    a.addu(T1, T1, T0);
+    a.addiu(T1, T1, 1);
+    a.sll(T3, T0, 2);
+    a.addu(T4, S0, T3);
+    a.sw(T1, 0, T4);
+    a.xori(T2, T0, 0x55);
+    a.addu(T4, S1, T3);
+    a.sw(T2, 0, T4);
+    a.addiu(T0, T0, 1);
+    a.bne(T0, T5, init);
+    a.nop();
+
+    a.li(S3, 400 * scale);
+    a.li(V0, 0);
+    a.bind(rep);
+    a.move(T1, S0);
+    a.move(T7, S2);
+    a.li(T8, 8);
+    a.bind(iloop);
+    a.move(T3, S1);
+    a.li(T9, 8);
+    a.bind(jloop);
+    a.li(T6, 0);
+    for ( int k = 0; k < 8; ++k ) {
+        a.lw(T4, 4*k, T1);
+        a.lw(T5, 32*k, T3);
+        a.mul(T4, T4, T5);
+        a.addu(T6, T6, T4);
+    }
+    a.sw(T6, 0, T7);
+    a.addu(V0, V0, T6);
+    a.addiu(T7, T7, 4);
+    a.addiu(T3, T3, 4);
+    a.addiu(T9, T9, -1);
+    a.bne(T9, ZERO, jloop);
+    a.nop();
+    a.addiu(T1, T1, 32);
+    a.addiu(T8, T8, -1);
+    a.bne(T8, ZERO, iloop);
+    a.nop();
+    repeatEnd(a, rep);
+}
+
+// CoreMark-like: walk of a 256-node linked list
+void listKernel( Assembler &a, uint32_t scale )
+{
+    Assembler::label_t build = a.label(), rep = a.label(), walk = a.label();
+
+    a.li(S0, KSEG0 | 0x10000);
+
+    // Node i is {next, value}, next being node (i+97)%256, value 7i
+    a.li(T0, 0);
+    a.li(T5, 256);
+    a.bind(build);
+    a.addiu(T1, T0, 97);
+    a.andi(T1, T1, 255);
+    a.sll(T1, T1, 3);
+    a.addu(T1, T1, S0);
+    a.sll(T2, T0, 3);
+    a.addu(T2, T2, S0);
+    a.sw(T1, 0, T2);
+    a.sll(T3, T0, 3);
+    a.subu(T3, T3, T0);
+    a.sw(T3, 4, T2);
+    a.addiu(T0, T0, 1);
+    a.bne(T0, T5, build);
+    a.nop();
+
+    a.li(S3, 800 * scale);
+    a.li(V0, 0);
+    a.bind(rep);
+    a.move(T0, S0);
+    a.li(T1, 256);
+    a.bind(walk);
+    a.lw(T2, 4, T0);
+    a.lw(T0, 0, T0);
+    a.addiu(T1, T1, -1);
+    a.bne(T1, ZERO, walk);
+    a.addu(V0, V0, T2);
+    repeatEnd(a, rep);
+}
+
+// 4KiB word copy, unrolled four times
+void memcpyKernel( Assembler &a, uint32_t scale )
+{
+    Assembler::label_t init = a.label(), rep = a.label();
+    Assembler::label_t copy = a.label(), sum = a.label();
+
+    a.li(S0, KSEG0 | 0x20000);
+    a.li(S1, KSEG0 | 0x30000);
+    a.li(S2, 0x1000);
+
+    a.li(T0, 0);
+    a.li(T5, 1024);
+    a.bind(init);
+    a.sll(T1, T0, 16);
+    a.xor_(T1, T1, T0);
+    a.xori(T1, T1, 0x5a5a);
+    a.sll(T2, T0, 2);
+    a.addu(T2, T2, S0);
+    a.sw(T1, 0, T2);
+    a.addiu(T0, T0, 1);
+    a.bne(T0, T5, init);
+    a.nop();
+
+    a.li(S3, 400 * scale);
+    a.bind(rep);
+    a.move(T0, S0);
+    a.move(T1, S1);
+    a.addu(T2, S0, S2);
+    a.bind(copy);
+    a.lw(T3, 0, T0);
+    a.lw(T4, 4, T0);
+    a.lw(T5, 8, T0);
+    a.lw(T6, 12, T0);
+    a.sw(T3, 0, T1);
+    a.sw(T4, 4, T1);
+    a.sw(T5, 8, T1);
+    a.sw(T6, 12, T1);
+    a.addiu(T0, T0, 16);
+    a.bne(T0, T2, copy);
+    a.addiu(T1, T1, 16);
+    repeatEnd(a, rep);
+
+    a.li(V0, 0);
+    a.move(T1, S1);
+    a.addu(T2, S1, S2);
+    a.bind(sum);
+    a.lw(T3, 0, T1);
+    a.addiu(T1, T1, 4);
+    a.bne(T1, T2, sum);
+    a.addu(V0, V0, T3);
+}
+
+// Bitwise CRC-32 of a 1KiB buffer
+void crcKernel( Assembler &a, uint32_t scale )
+{
+    Assembler::label_t init = a.label(), rep = a.label(), byte = a.label();
+
+    a.li(S0, KSEG0 | 0x40000);
+
+    a.li(T0, 0);
+    a.li(T5, 1024);
+    a.bind(init);
+    a.sll(T1, T0, 5);
+    a.subu(T1, T1, T0);
+    a.addiu(T1, T1, 7);
+    a.addu(T2, S0, T0);
+    a.sb(T1, 0, T2);
+    a.addiu(T0, T0, 1);
+    a.bne(T0, T5, init);
+    a.nop();
+
+    a.li(S1, 0xedb88320);
+    a.li(V0, 0xffffffff);
+    a.li(S3, 10 * scale);
+    a.bind(rep);
+    a.move(T0, S0);
+    a.addiu(T2, S0, 1024);
+    a.bind(byte);
+    a.lbu(T1, 0, T0);
+    a.addiu(T0, T0, 1);
+    a.xor_(V0, V0, T1);
+    for ( int bit = 0; bit < 8; ++bit ) {
+        a.andi(T3, V0, 1);
+        a.subu(T3, ZERO, T3);
+        a.and_(T3, T3, S1);
+        a.srl(V0, V0, 1);
+        a.xor_(V0, V0, T3);
+    }
+    a.bne(T0, T2, byte);
+    a.nop();
+    repeatEnd(a, rep);
+}
+
+// Decimal digit sums, one division per digit
+void divideKernel( Assembler &a, uint32_t scale )
+{
+    Assembler::label_t number = a.label(), digit = a.label();
+
+    a.li(S0, 1);
+    a.li(S1, 10);
+    a.li(S2, 0x9e3779b1);
+    a.li(S3, 8000 * scale);
+    a.li(V0, 0);
+    a.bind(number);
+    a.mul(T0, S0, S2);
+    a.bind(digit);
+    a.divu(T0, S1);
+    a.mfhi(T1);
+    a.mflo(T0);
+    a.bne(T0, ZERO, digit);
+    a.addu(V0, V0, T1);
+    a.addiu(S0, S0, 1);
+    repeatEnd(a, number);
+}
+
+// Xorshift loop under a timer interrupt every 200 cycles
+void irqKernel( Assembler &a, uint32_t scale )
+{
+    Assembler::label_t rep = a.label();
+
+    a.li(S6, 0);
+    a.li(S7, 200);
+    a.mfc0(T0, CP0_COUNT);
+    a.addu(T0, T0, S7);
+    a.mtc0(T0, CP0_COMPARE);
+    // BEV, IM7, IE
+    a.li(T0, 0x00408001);
+    a.mtc0(T0, CP0_STATUS);
+
+    a.li(V0, 1);
+    a.li(S3, 100000 * scale);
+    a.bind(rep);
+    a.sll(T0, V0, 13);
+    a.xor_(V0, V0, T0);
+    a.srl(T0, V0, 17);
+    a.xor_(V0, V0, T0);
+    a.sll(T0, V0, 5);
+    a.xor_(V0, V0, T0);
+    repeatEnd(a, rep);
+
+    // Status.IE off
+    a.li(T0, 0x00400000);
+    a.mtc0(T0, CP0_STATUS);
+}
+
+// One instruction kind, 32 times per loop iteration. t1, t2 and s0
+// (a RAM pointer) are set, t4 is the destination.
+enum OpKind {
+    OP_NOP,
+    OP_ADDU,
+    OP_SLL,
+    OP_LW,
+    OP_SW,
+    OP_MUL,
+    OP_MULT,
+    OP_DIVU,
+    OP_BRANCH,
+    OP_KIND_COUNT,
+};
+
+const char *const op_kind_names[] = {
+    "nop", "addu", "sll", "lw", "sw", "mul", "mult", "divu", "bne",
+};
+
+void opKernel( Assembler &a, uint32_t scale, enum OpKind kind )
+{
+    Assembler::label_t rep = a.label();
+
+    a.li(T1, 12345);
+    a.li(T2, 7);
+    a.li(S0, KSEG0 | 0x50000);
+    a.li(S3, 2000 * scale);
+    a.bind(rep);
+    for ( int n = 0; n < 32; ++n ) {
+        switch ( kind ) {
+        case OP_NOP: a.nop(); break;
+        case OP_ADDU: a.addu(T4, T1, T2); break;
+        case OP_SLL: a.sll(T4, T1, 3); break;
+        case OP_LW: a.lw(T4, 0, S0); break;
+        case OP_SW: a.sw(T1, 0, S0); break;
+        case OP_MUL: a.mul(T4, T1, T2); break;
+        case OP_MULT: a.mult(T1, T2); break;
+        case OP_DIVU: a.divu(T1, T2); break;
+        // Never taken
+        case OP_BRANCH: a.bne(ZERO, ZERO, rep); break;
+        default: break;
+        }
+    }
+    repeatEnd(a, rep);
+    a.li(V0, 0);
+}
+
+typedef void (*kernel_t)( Assembler &a, uint32_t scale );
+
+struct Kernel {
+    const char *name;
+    kernel_t build;
+};
+
+const Kernel kernels[] = {
+    { "matrix", matrixKernel },
+    { "list", listKernel },
+    { "memcpy", memcpyKernel },
+    { "crc", crcKernel },
+    { "divide", divideKernel },
+    { "irq", irqKernel },
+};
+
+std::vector<uint32_t> assemble( kernel_t build, uint32_t scale )
+{
+    Assembler a;
+    build( a, scale );
+    kernelExit( a );
+    exceptionVector( a );
+    return a.code();
+}
+
+void usage( const char *name )
+{
+    std::fprintf(stderr,
+                 "usage: %s [-m mode]... [-s scale] [-e] [-o] [kernel]...\n"
+                 "  -m  wrapper, dmi, jit or quantum (default: all)\n"
+                 "  -s  work multiplier (default: 1)\n"
+                 "  -e  big endian core\n"
+                 "  -o  per instruction kind costs\n"
+                 "kernels:", name);
+    for ( size_t i = 0; i < sizeof(kernels)/sizeof(kernels[0]); ++i )
+        std::fprintf(stderr, " %s", kernels[i].name);
+    std::fprintf(stderr, "\n");
+}
+
+}
+
+int main( int argc, char **argv )
+{
+    std::vector<Mode> modes;
+    uint32_t scale = 1;
+    bool big_endian = false;
+    bool op_costs = false;
+    int opt;
+
+    while ( (opt = getopt(argc, argv, "m:s:eoh")) != -1 ) {
+        switch ( opt ) {
+        case 'm': {
+            size_t m;
+            for ( m = 0; m < MODE_COUNT; ++m )
+                if ( ! std::strcmp(optarg, mode_names[m]) )
+                    break;
+            if ( m == MODE_COUNT ) {
+                usage(argv[0]);
+                return 1;
+            }
+            modes.push_back((Mode)m);
+            break;
+        }
+        case 's':
+            scale = std::atoi(optarg);
+            if ( scale == 0 )
+                scale = 1;
+            break;
+        case 'e':
+            big_endian = true;
+            break;
+        case 'o':
+            op_costs = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt != 'h';
+        }
+    }
+    if ( modes.empty() )
+        for ( size_t m = 0; m < MODE_COUNT; ++m )
+            modes.push_back((Mode)m);
+
+    std::vector<const Kernel*> selected;
+    for ( int i = optind; i < argc; ++i ) {
+        size_t k;
+        for ( k = 0; k < sizeof(kernels)/sizeof(kernels[0]); ++k )
+            if ( ! std::strcmp(argv[i], kernels[k].name) )
+                break;
+        if ( k == sizeof(kernels)/sizeof(kernels[0]) ) {
+            usage(argv[0]);
+            return 1;
+        }
+        selected.push_back(&kernels[k]);
+    }
+    if ( selected.empty() && ! op_costs )
+        for ( size_t k = 0; k < sizeof(kernels)/sizeof(kernels[0]); ++k )
+            selected.push_back(&kernels[k]);
+
+    FlatMemory mem;
+    int status = 0;
+
+    if ( ! selected.empty() )
+        std::printf("%-8s %-8s %12s %12s %8s %8s %10s %6s\n",
+                    "mode", "kernel", "instructions", "cycles", "ns/ins", "MIPS",
+                    "checksum", "irqs");
+    for ( size_t m = 0; m < modes.size(); ++m ) {
+        for ( size_t k = 0; k < selected.size(); ++k ) {
+            std::vector<uint32_t> code = assemble( selected[k]->build, scale );
+            Result r = run( code, modes[m], mem, big_endian );
+            if ( ! r.ok )
+                status = 1;
+            std::printf("%-8s %-8s %12llu %12llu %8.2f %8.2f 0x%08x %6u%s\n",
+                        mode_names[modes[m]], selected[k]->name,
+                        (unsigned long long)r.instructions,
+                        (unsigned long long)r.cycles,
+                        r.seconds * 1e9 / r.instructions,
+                        r.instructions / r.seconds * 1e-6,
+                        r.checksum, r.irqs,
+                        r.ok ? "" : " FAILED");
+        }
+    }
+
+    if ( ! op_costs )
+        return status;
+
+    if ( ! selected.empty() )
+        std::printf("\n");
+    std::printf("%-8s %-8s %8s %8s\n", "mode", "op", "ns/ins", "vs nop");
+    for ( size_t m = 0; m < modes.size(); ++m ) {
+        double nop_cost = 0;
+        for ( size_t op = 0; op < OP_KIND_COUNT; ++op ) {
+            Assembler a;
+            opKernel( a, scale, (OpKind)op );
+            kernelExit( a );
+            exceptionVector( a );
+            Result r = run( a.code(), modes[m], mem, big_endian );
+            double cost = r.seconds * 1e9 / r.instructions;
+            if ( op == OP_NOP )
+                nop_cost = cost;
+            if ( ! r.ok )
+                status = 1;
+            std::printf("%-8s %-8s %8.2f %+8.2f%s\n",
+                        mode_names[modes[m]], op_kind_names[op],
+                        cost, cost - nop_cost, r.ok ? "" : " FAILED");
+        }
+    }
+    return status;
+}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,492 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#ifndef _SOCLIB_MIPS32_BENCH_H_
+#define _SOCLIB_MIPS32_BENCH_H_
+
+// Shared by the standalone Mips32Iss programs of this directory: a
+// minimal assembler, a flat zero wait state memory, and a driver
+// running a program to its exit store in the various execution
+// modes of the core.
+
+#include "mips32.h"
+
+#include <vector>
+#include <time.h>
+
+namespace mips32_bench {
+
+using namespace soclib::common;
+
+typedef Iss2::addr_t addr_t;
+
+enum Reg {
+    ZERO, AT, V0, V1, A0, A1, A2, A3,
+    T0, T1, T2, T3, T4, T5, T6, T7,
+    S0, S1, S2, S3, S4, S5, S6, S7,
+    T8, T9, K0, K1, GP, SP, FP, RA,
+};
+
+enum Cp0Reg {
+    CP0_COUNT = 9,
+    CP0_COMPARE = 11,
+    CP0_USERLOCAL = 4,  // select 2
+    CP0_HWRENA = 7,
+    CP0_STATUS = 12,
+    CP0_CAUSE = 13,
+    CP0_EPC = 14,
+    CP0_EBASE = 15,     // select 1
+    CP0_CONFIG = 16,
+    CP0_PERF = 25,      // PerfCtl0, PerfCnt0 in select 1
+};
+
+enum Cp1Reg {
+    CP1_FCCR = 25,
+    CP1_FCSR = 31,
+};
+
+// Memory map: boot ROM holding the kernel code, RAM for its data,
+// and a word whose write ends the run (0 on success).
+const addr_t ROM_BASE = 0x1fc00000;
+const size_t ROM_SIZE = 0x1000;
+const addr_t RAM_BASE = 0x00000000;
+const size_t RAM_SIZE = 0x100000;
+const addr_t EXIT_ADDR = 0x1f000000;
+
+const addr_t KSEG0 = 0x80000000;
+const addr_t KSEG1 = 0xa0000000;
+
+// Offset of the exception vector in the ROM, Status.BEV being set
+const size_t VECTOR_OFFSET = 0x380;
+
+/**
+ * Minimal Mips32 assembler, enough for the benchmark kernels and the
+ * conformance programs. Branch targets are labels, resolved by
+ * code().
+ */
+class Assembler
+{
+public:
+    typedef size_t label_t;
+
+    label_t label()
+    {
+        m_labels.push_back((size_t)-1);
+        return m_labels.size() - 1;
+    }
+
+    void bind( label_t l )
+    {
+        m_labels[l] = m_code.size();
+    }
+
+    // Pads with nops up to a byte offset
+    void org( size_t offset )
+    {
+        while ( m_code.size() < offset / 4 )
+            nop();
+    }
+
+    std::vector<uint32_t> code() const
+    {
+        std::vector<uint32_t> code(m_code);
+        for ( size_t i = 0; i < m_fixups.size(); ++i ) {
+            size_t at = m_fixups[i].first;
+            int32_t offset = m_labels[m_fixups[i].second] - (at + 1);
+            code[at] |= offset & 0xffff;
+        }
+        return code;
+    }
+
+    void nop() { emit(0); }
+
+    void addu( int rd, int rs, int rt ) { r(0x21, rd, rs, rt); }
+    void subu( int rd, int rs, int rt ) { r(0x23, rd, rs, rt); }
+    void and_( int rd, int rs, int rt ) { r(0x24, rd, rs, rt); }
+    void xor_( int rd, int rs, int rt ) { r(0x26, rd, rs, rt); }
+    void sll( int rd, int rt, int sa ) { r(0x00, rd, 0, rt, sa); }
+    void srl( int rd, int rt, int sa ) { r(0x02, rd, 0, rt, sa); }
+    void mult( int rs, int rt ) { r(0x18, 0, rs, rt); }
+    void divu( int rs, int rt ) { r(0x1b, 0, rs, rt); }
+    void mfhi( int rd ) { r(0x10, rd, 0, 0); }
+    void mflo( int rd ) { r(0x12, rd, 0, 0); }
+    void mul( int rd, int rs, int rt ) { emit(0x70000002 | (rs<<21) | (rt<<16) | (rd<<11)); }
+    void move( int rd, int rs ) { addu(rd, rs, ZERO); }
+    void jr( int rs ) { r(0x08, 0, rs, 0); }
+    void jalr( int rs ) { r(0x09, RA, rs, 0); }
+    void movf( int rd, int rs, int cc ) { r(0x01, rd, rs, cc<<2); }
+    void movt( int rd, int rs, int cc ) { r(0x01, rd, rs, (cc<<2) | 1); }
+    void clz( int rd, int rs ) { emit(0x70000020 | (rs<<21) | (rd<<16) | (rd<<11)); }
+    void clo( int rd, int rs ) { emit(0x70000021 | (rs<<21) | (rd<<16) | (rd<<11)); }
+    void sdbbp() { emit(0x7000003f); }
+    void rdhwr( int rt, int rd ) { emit(0x7c00003b | (rt<<16) | (rd<<11)); }
+
+    void addiu( int rt, int rs, int16_t imm ) { i(0x09, rt, rs, imm); }
+    void andi( int rt, int rs, uint16_t imm ) { i(0x0c, rt, rs, imm); }
+    void ori( int rt, int rs, uint16_t imm ) { i(0x0d, rt, rs, imm); }
+    void xori( int rt, int rs, uint16_t imm ) { i(0x0e, rt, rs, imm); }
+    void sltiu( int rt, int rs, int16_t imm ) { i(0x0b, rt, rs, imm); }
+    void lui( int rt, uint16_t imm ) { i(0x0f, rt, 0, imm); }
+
+    void lbu( int rt, int16_t offset, int base ) { i(0x24, rt, base, offset); }
+    void lw( int rt, int16_t offset, int base ) { i(0x23, rt, base, offset); }
+    void sb( int rt, int16_t offset, int base ) { i(0x28, rt, base, offset); }
+    void sw( int rt, int16_t offset, int base ) { i(0x2b, rt, base, offset); }
+    void pref( int hint, int16_t offset, int base ) { i(0x33, hint, base, offset); }
+
+    void beq( int rs, int rt, label_t l ) { branch(0x04, rs, rt, l); }
+    void bne( int rs, int rt, label_t l ) { branch(0x05, rs, rt, l); }
+    void b( label_t l ) { beq(ZERO, ZERO, l); }
+    void beql( int rs, int rt, label_t l ) { branch(0x14, rs, rt, l); }
+    void bnel( int rs, int rt, label_t l ) { branch(0x15, rs, rt, l); }
+    void blezl( int rs, label_t l ) { branch(0x16, rs, 0, l); }
+    void bgtzl( int rs, label_t l ) { branch(0x17, rs, 0, l); }
+
+    // REGIMM immediate traps and synci
+    enum RegImm {
+        TGEI = 0x08,
+        TGEIU = 0x09,
+        TLTI = 0x0a,
+        TLTIU = 0x0b,
+        TEQI = 0x0c,
+        TNEI = 0x0e,
+        SYNCI = 0x1f,
+    };
+    void regimm( enum RegImm func, int rs, int16_t imm ) { i(0x01, func, rs, imm); }
+
+    void mfc0( int rt, int rd, int sel = 0 ) { emit(0x40000000 | (rt<<16) | (rd<<11) | sel); }
+    void mtc0( int rt, int rd, int sel = 0 ) { emit(0x40800000 | (rt<<16) | (rd<<11) | sel); }
+    void rdpgpr( int rd, int rt ) { emit(0x41400000 | (rt<<16) | (rd<<11)); }
+    void wrpgpr( int rd, int rt ) { emit(0x41c00000 | (rt<<16) | (rd<<11)); }
+    void eret() { emit(0x42000018); }
+    void mfc1( int rt, int fs ) { emit(0x44000000 | (rt<<16) | (fs<<11)); }
+    void cfc1( int rt, int fs ) { emit(0x44400000 | (rt<<16) | (fs<<11)); }
+    void mtc1( int rt, int fs ) { emit(0x44800000 | (rt<<16) | (fs<<11)); }
+    void ctc1( int rt, int fs ) { emit(0x44c00000 | (rt<<16) | (fs<<11)); }
+
+    void lwc1( int ft, int16_t offset, int base ) { i(0x31, ft, base, offset); }
+    void ldc1( int ft, int16_t offset, int base ) { i(0x35, ft, base, offset); }
+    void swc1( int ft, int16_t offset, int base ) { i(0x39, ft, base, offset); }
+    void sdc1( int ft, int16_t offset, int base ) { i(0x3d, ft, base, offset); }
+
+    // Floating point formats and operations, fmt field values and
+    // function codes
+    enum FpFmt {
+        FMT_S = 16,
+        FMT_D = 17,
+        FMT_W = 20,
+    };
+    enum FpFunc {
+        FADD = 0x00,
+        FSUB = 0x01,
+        FMUL = 0x02,
+        FDIV = 0x03,
+        FSQRT = 0x04,
+        FABS = 0x05,
+        FMOV = 0x06,
+        FNEG = 0x07,
+        FTRUNC_W = 0x0d,
+        FCVT_S = 0x20,
+        FCVT_D = 0x21,
+        FCVT_W = 0x24,
+    };
+    void fop( enum FpFmt fmt, enum FpFunc func, int fd, int fs, int ft = 0 )
+    {
+        emit(0x44000000 | (fmt<<21) | (ft<<16) | (fs<<11) | (fd<<6) | func);
+    }
+    // c.cond.fmt, setting condition code cc
+    void fcmp( enum FpFmt fmt, int cond, int cc, int fs, int ft )
+    {
+        emit(0x44000030 | (fmt<<21) | (ft<<16) | (fs<<11) | (cc<<8) | cond);
+    }
+    void bc1f( int cc, label_t l ) { branch(0x11, 8, cc<<2, l); }
+    void bc1t( int cc, label_t l ) { branch(0x11, 8, (cc<<2) | 1, l); }
+    void bc1fl( int cc, label_t l ) { branch(0x11, 8, (cc<<2) | 2, l); }
+    void bc1tl( int cc, label_t l ) { branch(0x11, 8, (cc<<2) | 3, l); }
+
+    void li( int rt, uint32_t value )
+    {
+        if ( (int32_t)value >= -0x8000 && (int32_t)value < 0x8000 ) {
+            addiu(rt, ZERO, value);
+        } else {
+            lui(rt, value >> 16);
+            if ( value & 0xffff )
+                ori(rt, rt, value);
+        }
+    }
+
+private:
+    std::vector<uint32_t> m_code;
+    std::vector<size_t> m_labels;
+    std::vector<std::pair<size_t, label_t> > m_fixups;
+
+    void emit( uint32_t ins ) { m_code.push_back(ins); }
+
+    void r( uint32_t func, int rd, int rs, int rt, int sa = 0 )
+    {
+        emit((rs<<21) | (rt<<16) | (rd<<11) | (sa<<6) | func);
+    }
+
+    void i( uint32_t op, int rt, int rs, uint16_t imm )
+    {
+        emit((op<<26) | (rs<<21) | (rt<<16) | imm);
+    }
+
+    void branch( uint32_t op, int rs, int rt, label_t l )
+    {
+        m_fixups.push_back(std::make_pair(m_code.size(), l));
+        i(op, rt, rs, 0);
+    }
+};
+
+
+/**
+ * Zero wait state memory, for both the wrapper-like loop and
+ * executeQuantum(). Words are little endian, as on the VCI bus.
+ */
+class FlatMemory
+    : public Iss2::LtMemory
+{
+public:
+    FlatMemory()
+        : m_rom(ROM_SIZE), m_ram(RAM_SIZE), m_little_endian(true)
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        std::fill(m_rom.begin(), m_rom.end(), 0);
+        std::fill(m_ram.begin(), m_ram.end(), 0);
+        m_exited = false;
+        m_exit_code = 0;
+    }
+
+    // Program words are stored in the core byte order
+    void load( const std::vector<uint32_t> &code, bool little_endian )
+    {
+        m_little_endian = little_endian;
+        for ( size_t i = 0; i < code.size() && 4*i < ROM_SIZE; ++i )
+            for ( size_t b = 0; b < 4; ++b )
+                m_rom[4*i + b] = code[i] >> (little_endian ? 8*b : 24 - 8*b);
+    }
+
+    uint8_t *rom() { return &m_rom[0]; }
+    uint8_t *ram() { return &m_ram[0]; }
+
+    bool exited() const { return m_exited; }
+    uint32_t exitCode() const { return m_exit_code; }
+
+    uint32_t fetch( const struct Iss2::InstructionRequest &req,
+                    struct Iss2::InstructionResponse &rsp,
+                    uint32_t,
+                    bool & )
+    {
+        const uint8_t *p = word( req.addr );
+        rsp.valid = true;
+        rsp.error = !p;
+        rsp.instruction = p ? get32( p ) : 0;
+        return 0;
+    }
+
+    uint32_t access( const struct Iss2::DataRequest &req,
+                     struct Iss2::DataResponse &rsp,
+                     uint32_t,
+                     bool &sync )
+    {
+        rsp.valid = true;
+        rsp.error = false;
+        rsp.rdata = 0;
+
+        if ( req.type == Iss2::XTN_READ || req.type == Iss2::XTN_WRITE )
+            return 0;
+
+        if ( (req.addr & 0x1fffffff) == EXIT_ADDR ) {
+            m_exited = true;
+            // Exit word is a register stored in the core byte order
+            m_exit_code = m_little_endian
+                ? req.wdata : soclib::endian::uint32_swap(req.wdata);
+            sync = true;
+            return 0;
+        }
+
+        uint8_t *p = word( req.addr );
+        if ( ! p ) {
+            rsp.error = true;
+            return 0;
+        }
+        switch ( req.type ) {
+        case Iss2::DATA_READ:
+        case Iss2::DATA_LL:
+            rsp.rdata = get32( p );
+            break;
+        case Iss2::DATA_SC:
+        case Iss2::DATA_WRITE:
+            for ( size_t b = 0; b < 4; ++b )
+                if ( req.be & (1 << b) )
+                    p[b] = req.wdata >> (8*b);
+            break;
+        default:
+            break;
+        }
+        return 0;
+    }
+
+private:
+    std::vector<uint8_t> m_rom;
+    std::vector<uint8_t> m_ram;
+    bool m_little_endian;
+    bool m_exited;
+    uint32_t m_exit_code;
+
+    uint8_t *word( addr_t addr )
+    {
+        addr_t phys = addr & 0x1ffffffc;
+        if ( phys - ROM_BASE < ROM_SIZE )
+            return &m_rom[phys - ROM_BASE];
+        if ( phys - RAM_BASE < RAM_SIZE )
+            return &m_ram[phys - RAM_BASE];
+        return NULL;
+    }
+
+    static uint32_t get32( const uint8_t *p )
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+};
+
+enum Mode {
+    MODE_WRAPPER,
+    MODE_DMI,
+    MODE_JIT,
+    MODE_QUANTUM,
+    MODE_COUNT,
+};
+
+const char *const mode_names[] = {
+    "wrapper", "dmi", "jit", "quantum",
+};
+
+struct Result {
+    // Exited with a zero exit word
+    bool ok;
+    bool exited;
+    uint32_t exit_code;
+    uint64_t instructions;
+    uint64_t cycles;
+    double seconds;
+    // v0 and s6 at exit
+    uint32_t checksum;
+    uint32_t irqs;
+};
+
+inline double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Runs `code', loaded at the reset vector, until its exit store, or
+// `max_cycles'.
+template <typename iss_t>
+Result run( const std::vector<uint32_t> &code, enum Mode mode, FlatMemory &mem,
+            uint64_t max_cycles = (uint64_t)1 << 36 )
+{
+    Result r;
+    iss_t iss("bench", 0);
+
+    mem.clear();
+    mem.load( code, iss_t::s_endianness == Iss2::ISS_LITTLE_ENDIAN );
+    iss.reset();
+    if ( mode == MODE_DMI || mode == MODE_JIT ) {
+        iss.dmiGrant( KSEG1 | ROM_BASE, ROM_SIZE, mem.rom(), Iss2::DMI_READ );
+        iss.dmiGrant( KSEG0 | RAM_BASE, RAM_SIZE, mem.ram(), Iss2::DMI_READ_WRITE );
+        iss.setBlockExecution( true );
+        iss.setJit( mode == MODE_JIT );
+    }
+
+    uint32_t retired = iss.retiredCount();
+    uint64_t cycles = 0;
+    double start = now();
+
+    if ( mode == MODE_QUANTUM ) {
+        while ( ! mem.exited() && cycles < max_cycles )
+            cycles += iss.executeQuantum( 10000, mem, 0 );
+    } else {
+        const uint32_t ncycle = mode == MODE_WRAPPER ? 1 : 10000;
+        while ( ! mem.exited() && cycles < max_cycles ) {
+            struct Iss2::InstructionRequest ireq = ISS_IREQ_INITIALIZER;
+            struct Iss2::DataRequest dreq = ISS_DREQ_INITIALIZER;
+            struct Iss2::InstructionResponse irsp = ISS_IRSP_INITIALIZER;
+            struct Iss2::DataResponse drsp = ISS_DRSP_INITIALIZER;
+            bool sync;
+
+            iss.getRequests( ireq, dreq );
+            if ( ireq.valid )
+                mem.fetch( ireq, irsp, 0, sync );
+            if ( dreq.valid )
+                mem.access( dreq, drsp, 0, sync );
+            // Only deliver the exit write response
+            cycles += iss.executeNCycles( mem.exited() ? 1 : ncycle, irsp, drsp, 0 );
+        }
+    }
+
+    r.seconds = now() - start;
+    r.ok = mem.exited() && mem.exitCode() == 0;
+    r.exited = mem.exited();
+    r.exit_code = mem.exitCode();
+    r.instructions = (uint32_t)(iss.retiredCount() - retired);
+    r.cycles = cycles;
+    r.checksum = iss.debugGetRegisterValue(V0);
+    r.irqs = iss.debugGetRegisterValue(S6);
+    return r;
+}
+
+inline Result run( const std::vector<uint32_t> &code, enum Mode mode, FlatMemory &mem,
+                   bool big_endian, uint64_t max_cycles = (uint64_t)1 << 36 )
+{
+    if ( big_endian )
+        return run<Mips32EbIss>( code, mode, mem, max_cycles );
+    return run<Mips32ElIss>( code, mode, mem, max_cycles );
+}
+
+}
+
+#endif /* _SOCLIB_MIPS32_BENCH_H_ */
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,832 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+// Self-checking programs for the MIPS32r2 encodings decoded late in
+// Mips32Iss: branch likely, also under interrupts, REGIMM traps,
+// synci, pref, movf/movt, sdbbp, rdpgpr/wrpgpr, rdhwr and clz/clo,
+// and for the floating point unit.
+//
+// Built like mips32_bench, see there. Usage:
+//
+//   mips32_conformance [test]...
+//
+// Each program runs on both endiannesses, through executeQuantum()
+// and through DMI block execution. It reports its result with the
+// exit store: 0 on success, the number of the failed check otherwise.
+
+#include "mips32_bench.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace mips32_bench;
+
+namespace {
+
+enum ExcCode {
+    EXC_BP = 9,
+    EXC_CPU = 11,
+    EXC_TR = 13,
+    EXC_FPE = 15,
+};
+
+/**
+ * Program skeleton: the exception handler records Cause.ExcCode in
+ * s5, counts exceptions in s4 and skips the faulting instruction,
+ * which must not be in a delay slot. Timer interrupts are rearmed
+ * with the period in s7 and counted in s6. Checks clobber at, t8
+ * and t9.
+ */
+class Test
+    : public Assembler
+{
+    label_t m_fail;
+    uint32_t m_checks;
+
+public:
+    Test()
+        : m_fail(label()), m_checks(0)
+    {
+        label_t body = label();
+        b(body);
+        nop();
+
+        label_t exception = label();
+        org(VECTOR_OFFSET);
+        mfc0(K0, CP0_CAUSE);
+        srl(K0, K0, 2);
+        andi(K0, K0, 0x1f);
+        bne(K0, ZERO, exception);
+        nop();
+        // Timer interrupt, rearmed
+        mfc0(K0, CP0_COUNT);
+        addu(K0, K0, S7);
+        mtc0(K0, CP0_COMPARE);
+        addiu(S6, S6, 1);
+        eret();
+        bind(exception);
+        move(S5, K0);
+        addiu(S4, S4, 1);
+        // This core leaves EPC on the instruction following the
+        // faulting one, so eret alone resumes past it
+        eret();
+
+        // t8 holds the failed check
+        bind(m_fail);
+        li(K0, KSEG1 | EXIT_ADDR);
+        sw(T8, 0, K0);
+        b(m_fail);
+        nop();
+
+        bind(body);
+        // Leave the reset state, so that eret returns to EPC
+        li(T0, 0x00400000);
+        mtc0(T0, CP0_STATUS);
+        li(S4, 0);
+    }
+
+    void expect( int reg, uint32_t value )
+    {
+        li(T8, ++m_checks);
+        li(AT, value);
+        bne(reg, AT, m_fail);
+        nop();
+    }
+
+    void expectReg( int reg, int other )
+    {
+        li(T8, ++m_checks);
+        bne(reg, other, m_fail);
+        nop();
+    }
+
+    void expectNonZero( int reg )
+    {
+        li(T8, ++m_checks);
+        beq(reg, ZERO, m_fail);
+        nop();
+    }
+
+    // Timer interrupt every `period' cycles, counted in s6
+    void irqOn( uint32_t period )
+    {
+        li(S6, 0);
+        li(S7, period);
+        mfc0(T9, CP0_COUNT);
+        addu(T9, T9, S7);
+        mtc0(T9, CP0_COMPARE);
+        // IM7, IE
+        mfc0(T9, CP0_STATUS);
+        ori(T9, T9, 0x8001);
+        mtc0(T9, CP0_STATUS);
+    }
+
+    void irqOff()
+    {
+        mfc0(T9, CP0_STATUS);
+        ori(T9, T9, 0x8001);
+        xori(T9, T9, 0x8001);
+        mtc0(T9, CP0_STATUS);
+    }
+
+    // CU1, BEV, and a clear FCSR
+    void fpuOn()
+    {
+        li(T9, 0x20400000);
+        mtc0(T9, CP0_STATUS);
+        ctc1(ZERO, CP1_FCSR);
+    }
+
+    void fpuSet( int fs, uint32_t bits )
+    {
+        li(T9, bits);
+        mtc1(T9, fs);
+    }
+
+    void fpuSetDouble( int fs, uint64_t bits )
+    {
+        fpuSet(fs, bits);
+        fpuSet(fs + 1, bits >> 32);
+    }
+
+    void expectFpu( int fs, uint32_t bits )
+    {
+        mfc1(T9, fs);
+        expect(T9, bits);
+    }
+
+    void expectFpuDouble( int fs, uint64_t bits )
+    {
+        expectFpu(fs, bits);
+        expectFpu(fs + 1, bits >> 32);
+    }
+
+    void expectFcsr( uint32_t value )
+    {
+        cfc1(T9, CP1_FCSR);
+        expect(T9, value);
+    }
+
+    // Exactly one exception since the previous one
+    void expectException( enum ExcCode code )
+    {
+        expect(S4, 1);
+        expect(S5, code);
+        li(S4, 0);
+    }
+
+    std::vector<uint32_t> finish()
+    {
+        expect(S4, 0);
+        li(T0, KSEG1 | EXIT_ADDR);
+        sw(ZERO, 0, T0);
+        label_t self = label();
+        bind(self);
+        b(self);
+        nop();
+        return code();
+    }
+};
+
+// t0 is 1 and t1 is -1, fcc0 is set and fcc1 is clear. `taken'
+// selects operands taking the branch.
+enum Likely {
+    BEQL,
+    BNEL,
+    BLEZL,
+    BGTZL,
+    BC1FL,
+    BC1TL,
+};
+
+void likelyBranch( Test &t, enum Likely kind, bool taken, Assembler::label_t l )
+{
+    switch ( kind ) {
+    case BEQL: t.beql(T0, taken ? T0 : ZERO, l); break;
+    case BNEL: t.bnel(T0, taken ? ZERO : T0, l); break;
+    case BLEZL: t.blezl(taken ? T1 : T0, l); break;
+    case BGTZL: t.bgtzl(taken ? T0 : T1, l); break;
+    case BC1FL: t.bc1fl(taken ? 1 : 0, l); break;
+    case BC1TL: t.bc1tl(taken ? 0 : 1, l); break;
+    }
+}
+
+// Taken: delay slot runs, fall-through is skipped. Not taken: delay
+// slot is annulled.
+void likelyTest( Test &t, enum Likely kind )
+{
+    t.li(T0, 1);
+    t.li(T1, -1);
+    for ( int taken = 1; taken >= 0; --taken ) {
+        Assembler::label_t target = t.label();
+        t.li(V0, 0);
+        likelyBranch(t, kind, taken, target);
+        t.addiu(V0, V0, 1);
+        t.addiu(V0, V0, 10);
+        t.bind(target);
+        t.expect(V0, taken ? 1 : 10);
+    }
+}
+
+void testBeql( Test &t ) { likelyTest(t, BEQL); }
+void testBnel( Test &t ) { likelyTest(t, BNEL); }
+void testBlezl( Test &t )
+{
+    likelyTest(t, BLEZL);
+    // Zero is taken too
+    Assembler::label_t target = t.label();
+    t.li(V0, 0);
+    t.blezl(ZERO, target);
+    t.addiu(V0, V0, 1);
+    t.addiu(V0, V0, 10);
+    t.bind(target);
+    t.expect(V0, 1);
+}
+void testBgtzl( Test &t ) { likelyTest(t, BGTZL); }
+
+// Interrupts landing right after a not taken branch likely must not
+// resume in its annulled delay slot
+void likelyIrqTest( Test &t, enum Likely kind )
+{
+    t.li(T0, 1);
+    t.li(T1, -1);
+    // Periods prime to the loop length, to hit every instruction
+    static const uint32_t periods[] = { 97, 101 };
+    for ( size_t p = 0; p < sizeof(periods)/sizeof(periods[0]); ++p ) {
+        Assembler::label_t loop = t.label();
+        Assembler::label_t never = t.label();
+        t.li(V0, 0);
+        t.li(S3, 1000);
+        t.irqOn(periods[p]);
+        t.bind(loop);
+        likelyBranch(t, kind, false, never);
+        t.addiu(V0, V0, 1);
+        t.addiu(S3, S3, -1);
+        t.bne(S3, ZERO, loop);
+        t.nop();
+        t.bind(never);
+        t.irqOff();
+        t.expect(V0, 0);
+        t.expectNonZero(S6);
+    }
+}
+
+void testLikelyIrq( Test &t )
+{
+    likelyIrqTest(t, BEQL);
+    likelyIrqTest(t, BNEL);
+    likelyIrqTest(t, BLEZL);
+    likelyIrqTest(t, BGTZL);
+}
+
+void trapCase( Test &t, enum Assembler::RegImm func, uint32_t rs, int16_t imm, bool traps )
+{
+    t.li(T0, rs);
+    t.regimm(func, T0, imm);
+    if ( traps )
+        t.expectException(EXC_TR);
+    else
+        t.expect(S4, 0);
+}
+
+void testTgei( Test &t )
+{
+    trapCase(t, Assembler::TGEI, 5, 5, true);
+    trapCase(t, Assembler::TGEI, -3, -2, false);
+}
+
+// Immediate is sign extended, then compared unsigned
+void testTgeiu( Test &t )
+{
+    trapCase(t, Assembler::TGEIU, -1, -2, true);
+    trapCase(t, Assembler::TGEIU, 0x7fffffff, -2, false);
+}
+
+void testTlti( Test &t )
+{
+    trapCase(t, Assembler::TLTI, -3, -2, true);
+    trapCase(t, Assembler::TLTI, 5, 5, false);
+}
+
+void testTltiu( Test &t )
+{
+    trapCase(t, Assembler::TLTIU, 0x7fffffff, -2, true);
+    trapCase(t, Assembler::TLTIU, -1, 2, false);
+}
+
+void testTeqi( Test &t )
+{
+    trapCase(t, Assembler::TEQI, -7, -7, true);
+    trapCase(t, Assembler::TEQI, 7, 8, false);
+}
+
+void testTnei( Test &t )
+{
+    trapCase(t, Assembler::TNEI, 7, 8, true);
+    trapCase(t, Assembler::TNEI, -7, -7, false);
+}
+
+// Code written to RAM runs once synci'd
+void testSynci( Test &t )
+{
+    t.li(A0, KSEG0 | 0x2000);
+    // addiu v0, zero, 1; jr ra; nop
+    t.li(T0, 0x24020001);
+    t.sw(T0, 0, A0);
+    t.li(T0, 0x03e00008);
+    t.sw(T0, 4, A0);
+    t.sw(ZERO, 8, A0);
+    t.regimm(Assembler::SYNCI, A0, 0);
+    t.jalr(A0);
+    t.nop();
+    t.expect(V0, 1);
+
+    // addiu v0, zero, 2
+    t.li(T0, 0x24020002);
+    t.sw(T0, 0, A0);
+    t.regimm(Assembler::SYNCI, A0, 0);
+    t.jalr(A0);
+    t.nop();
+    t.expect(V0, 2);
+}
+
+// Only a hint, must neither fault nor write anything
+void testPref( Test &t )
+{
+    t.li(A0, KSEG0 | 0x2000);
+    t.li(T0, 0x1234);
+    t.sw(T0, 0, A0);
+    t.pref(0, 0, A0);
+    t.pref(1, 0, A0);
+    t.pref(30, 4, A0);
+    t.lw(V0, 0, A0);
+    t.expect(V0, 0x1234);
+}
+
+void testMovci( Test &t )
+{
+    // CU1, BEV
+    t.li(T0, 0x20400000);
+    t.mtc0(T0, CP0_STATUS);
+    // FCC0 set, FCC1 clear
+    t.li(T0, 1 << 23);
+    t.ctc1(T0, CP1_FCSR);
+    t.li(T1, 0x1234);
+    t.li(V0, 0);
+    t.li(V1, 0);
+    t.movt(V0, T1, 0);
+    t.movf(V1, T1, 0);
+    t.expect(V0, 0x1234);
+    t.expect(V1, 0);
+    t.li(V0, 0);
+    t.li(V1, 0);
+    t.movt(V0, T1, 1);
+    t.movf(V1, T1, 1);
+    t.expect(V0, 0);
+    t.expect(V1, 0x1234);
+
+    // Coprocessor unusable without CU1
+    t.li(T0, 0x00400000);
+    t.mtc0(T0, CP0_STATUS);
+    t.li(V0, 0);
+    t.movt(V0, T1, 0);
+    t.expectException(EXC_CPU);
+    t.expect(V0, 0);
+}
+
+void testSdbbp( Test &t )
+{
+    t.sdbbp();
+    t.expectException(EXC_BP);
+}
+
+// Single register set: previous set is the current one
+void testPgpr( Test &t )
+{
+    t.li(T0, 0x5a5aa5a5);
+    t.li(V0, 0);
+    t.rdpgpr(V0, T0);
+    t.expect(V0, 0x5a5aa5a5);
+    t.li(T0, 0x12345678);
+    t.li(V1, 0);
+    t.wrpgpr(V1, T0);
+    t.expect(V1, 0x12345678);
+}
+
+void testRdhwr( Test &t )
+{
+    // CPUNum, from EBase
+    t.rdhwr(V0, 0);
+    t.mfc0(T0, CP0_EBASE, 1);
+    t.andi(T0, T0, 0x3ff);
+    t.expectReg(V0, T0);
+
+    // SYNCI_Step, a power of two
+    t.rdhwr(V0, 1);
+    t.expectNonZero(V0);
+    t.addiu(T0, V0, -1);
+    t.and_(T0, T0, V0);
+    t.expect(T0, 0);
+
+    // CC, follows Count
+    t.mfc0(T0, CP0_COUNT);
+    t.rdhwr(V0, 2);
+    t.subu(T1, V0, T0);
+    t.sltiu(T1, T1, 16);
+    t.expect(T1, 1);
+
+    // CCRes
+    t.rdhwr(V0, 3);
+    t.expect(V0, 1);
+
+    // ULR, from UserLocal
+    t.li(T0, 0xcafe1234);
+    t.mtc0(T0, CP0_USERLOCAL, 2);
+    t.rdhwr(V0, 29);
+    t.expect(V0, 0xcafe1234);
+}
+
+void testClz( Test &t )
+{
+    static const uint32_t cases[][2] = {
+        { 0, 32 }, { 1, 31 }, { 0x80000000, 0 }, { 0x00010000, 15 },
+    };
+    for ( size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); ++i ) {
+        t.li(T0, cases[i][0]);
+        t.clz(V0, T0);
+        t.expect(V0, cases[i][1]);
+    }
+}
+
+void testClo( Test &t )
+{
+    static const uint32_t cases[][2] = {
+        { 0xffffffff, 32 }, { 0xfffffff0, 28 }, { 0, 0 }, { 0x7fffffff, 0 },
+    };
+    for ( size_t i = 0; i < sizeof(cases)/sizeof(cases[0]); ++i ) {
+        t.li(T0, cases[i][0]);
+        t.clo(V0, T0);
+        t.expect(V0, cases[i][1]);
+    }
+}
+
+// FCSR fields
+enum {
+    FCSR_FLAG_I = 1 << 2,
+    FCSR_FLAG_V = 1 << 6,
+    FCSR_ENABLE_I = 1 << 7,
+    FCSR_ENABLE_Z = 1 << 10,
+    FCSR_CAUSE_I = 1 << 12,
+    FCSR_CAUSE_Z = 1 << 15,
+    FCSR_CAUSE_V = 1 << 16,
+    FCSR_FCC0 = 1 << 23,
+};
+
+// c.cond.fmt conditions
+enum {
+    C_F = 0x0,
+    C_UN = 0x1,
+    C_EQ = 0x2,
+    C_LT = 0xc,
+};
+
+const uint32_t ONE_S = 0x3f800000;
+const uint32_t THREE_S = 0x40400000;
+const uint32_t QNAN_S = 0x7fbfffff;
+
+void fpuCondition( Test &t )
+{
+    t.fpuOn();
+    t.li(T0, FCSR_FCC0);
+    t.ctc1(T0, CP1_FCSR);
+}
+
+void testBc1l( Test &t )
+{
+    fpuCondition(t);
+    likelyTest(t, BC1FL);
+    likelyTest(t, BC1TL);
+    likelyIrqTest(t, BC1FL);
+    likelyIrqTest(t, BC1TL);
+}
+
+void testFpBranch( Test &t )
+{
+    fpuCondition(t);
+    // Delay slot always runs
+    for ( int taken = 1; taken >= 0; --taken ) {
+        Assembler::label_t target = t.label();
+        t.li(V0, 0);
+        t.bc1t(taken ? 0 : 1, target);
+        t.addiu(V0, V0, 1);
+        t.addiu(V0, V0, 10);
+        t.bind(target);
+        t.expect(V0, taken ? 1 : 11);
+    }
+    Assembler::label_t target = t.label();
+    t.li(V0, 0);
+    t.bc1f(1, target);
+    t.addiu(V0, V0, 1);
+    t.addiu(V0, V0, 10);
+    t.bind(target);
+    t.expect(V0, 1);
+}
+
+// Compares are exact: no flag left by a previous inexact operation,
+// invalid only on signaling compares of NaNs
+void testFpCompare( Test &t )
+{
+    t.fpuOn();
+    t.fpuSet(0, ONE_S);
+    t.fpuSet(1, THREE_S);
+    t.fpuSet(3, QNAN_S);
+
+    t.fop(Assembler::FMT_S, Assembler::FDIV, 2, 0, 1);
+    t.ctc1(ZERO, CP1_FCSR);
+    t.fcmp(Assembler::FMT_S, C_EQ, 0, 0, 0);
+    t.expectFcsr(FCSR_FCC0);
+
+    // Even with the inexact trap enabled
+    t.fop(Assembler::FMT_S, Assembler::FDIV, 2, 0, 1);
+    t.li(T0, FCSR_ENABLE_I);
+    t.ctc1(T0, CP1_FCSR);
+    t.fcmp(Assembler::FMT_S, C_EQ, 0, 0, 0);
+    t.expect(S4, 0);
+    t.expectFcsr(FCSR_ENABLE_I | FCSR_FCC0);
+
+    t.ctc1(ZERO, CP1_FCSR);
+    t.fcmp(Assembler::FMT_S, C_EQ, 0, 3, 0);
+    t.expectFcsr(0);
+    t.fcmp(Assembler::FMT_S, C_LT, 0, 3, 0);
+    t.expectFcsr(FCSR_CAUSE_V | FCSR_FLAG_V);
+    t.fcmp(Assembler::FMT_S, C_UN, 0, 3, 0);
+    t.expectFcsr(FCSR_FCC0 | FCSR_FLAG_V);
+    t.fcmp(Assembler::FMT_S, C_F, 0, 0, 0);
+    t.expectFcsr(FCSR_FLAG_V);
+}
+
+void testFpArith( Test &t )
+{
+    t.fpuOn();
+    // 1.5, 2.25
+    t.fpuSet(0, 0x3fc00000);
+    t.fpuSet(1, 0x40100000);
+    t.fop(Assembler::FMT_S, Assembler::FADD, 2, 0, 1);
+    t.expectFpu(2, 0x40700000);
+    t.fop(Assembler::FMT_S, Assembler::FSUB, 2, 0, 1);
+    t.expectFpu(2, 0xbf400000);
+    t.fop(Assembler::FMT_S, Assembler::FMUL, 2, 0, 1);
+    t.expectFpu(2, 0x40580000);
+    t.fop(Assembler::FMT_S, Assembler::FNEG, 2, 0);
+    t.expectFpu(2, 0xbfc00000);
+    t.fop(Assembler::FMT_S, Assembler::FABS, 3, 2);
+    t.expectFpu(3, 0x3fc00000);
+    t.fop(Assembler::FMT_S, Assembler::FSQRT, 2, 1);
+    t.expectFpu(2, 0x3fc00000);
+    t.expectFcsr(0);
+
+    // 1/3 under round to nearest, then toward zero
+    t.fpuSet(0, ONE_S);
+    t.fpuSet(1, THREE_S);
+    t.fop(Assembler::FMT_S, Assembler::FDIV, 2, 0, 1);
+    t.expectFpu(2, 0x3eaaaaab);
+    t.expectFcsr(FCSR_CAUSE_I | FCSR_FLAG_I);
+    t.li(T0, 1);
+    t.ctc1(T0, CP1_FCSR);
+    t.fop(Assembler::FMT_S, Assembler::FDIV, 2, 0, 1);
+    t.expectFpu(2, 0x3eaaaaaa);
+    t.ctc1(ZERO, CP1_FCSR);
+
+    // Doubles: 2.25 and 1/3
+    t.fpuSetDouble(4, 0x4002000000000000ULL);
+    t.fop(Assembler::FMT_D, Assembler::FSQRT, 6, 4);
+    t.expectFpuDouble(6, 0x3ff8000000000000ULL);
+    t.fop(Assembler::FMT_S, Assembler::FCVT_D, 8, 0);
+    t.fop(Assembler::FMT_S, Assembler::FCVT_D, 10, 1);
+    t.fop(Assembler::FMT_D, Assembler::FDIV, 6, 8, 10);
+    t.expectFpuDouble(6, 0x3fd5555555555555ULL);
+
+    // Conversions: 3.75 rounds to 4, truncates to 3
+    t.fpuSet(0, 0x40700000);
+    t.fop(Assembler::FMT_S, Assembler::FCVT_W, 2, 0);
+    t.expectFpu(2, 4);
+    t.fop(Assembler::FMT_S, Assembler::FTRUNC_W, 2, 0);
+    t.expectFpu(2, 3);
+    t.fpuSet(0, 7);
+    t.fop(Assembler::FMT_W, Assembler::FCVT_S, 2, 0);
+    t.expectFpu(2, 0x40e00000);
+}
+
+// Enabled exceptions trap, leaving the destination unwritten and the
+// flags untouched
+void testFpTrap( Test &t )
+{
+    t.fpuOn();
+    t.li(T0, FCSR_ENABLE_Z);
+    t.ctc1(T0, CP1_FCSR);
+    t.fpuSet(0, ONE_S);
+    t.fpuSet(1, 0);
+    t.fpuSet(2, 0x12345678);
+    t.fop(Assembler::FMT_S, Assembler::FDIV, 2, 0, 1);
+    t.expectException(EXC_FPE);
+    t.expectFpu(2, 0x12345678);
+    t.expectFcsr(FCSR_ENABLE_Z | FCSR_CAUSE_Z);
+    t.ctc1(ZERO, CP1_FCSR);
+}
+
+// Swaps a and b on a big endian core, clobbers t9
+void bigEndianSwap( Test &t, int a, int b )
+{
+    Assembler::label_t little = t.label();
+    t.mfc0(T9, CP0_CONFIG);
+    t.andi(T9, T9, 0x8000);
+    t.beq(T9, ZERO, little);
+    t.nop();
+    t.move(T9, a);
+    t.move(a, b);
+    t.move(b, T9);
+    t.bind(little);
+}
+
+enum {
+    PERF_EVENT_LOADS = 2,
+    PERF_EVENT_STORES = 3,
+};
+
+// Counts `event' in kernel mode over a ldc1 or sdc1 from a0
+void perfCountOne( Test &t, uint32_t event, bool load )
+{
+    t.mtc0(ZERO, CP0_PERF, 1);
+    t.li(T0, (event << 5) | 0x2);
+    t.mtc0(T0, CP0_PERF, 0);
+    if ( load )
+        t.ldc1(4, 0, A0);
+    else
+        t.sdc1(4, 0, A0);
+    t.mtc0(ZERO, CP0_PERF, 0);
+    t.mfc0(V0, CP0_PERF, 1);
+    t.expect(V0, 1);
+}
+
+// Doubles are stored in the core byte order
+void testFpMemory( Test &t )
+{
+    t.fpuOn();
+    t.li(A0, KSEG0 | 0x2000);
+
+    t.li(T0, 0x12345678);
+    t.sw(T0, 0, A0);
+    t.lwc1(2, 0, A0);
+    t.expectFpu(2, 0x12345678);
+    t.fpuSet(2, 0x9abcdef0);
+    t.swc1(2, 4, A0);
+    t.lw(V0, 4, A0);
+    t.expect(V0, 0x9abcdef0);
+
+    // Double 1.5 plus one ulp, doubled
+    t.li(T0, 0x00000001);
+    t.li(T1, 0x3ff80000);
+    bigEndianSwap(t, T0, T1);
+    t.sw(T0, 0, A0);
+    t.sw(T1, 4, A0);
+    t.ldc1(4, 0, A0);
+    t.fop(Assembler::FMT_D, Assembler::FADD, 6, 4, 4);
+    t.expectFpuDouble(6, 0x4008000000000001ULL);
+    t.sdc1(6, 8, A0);
+    t.lw(T0, 8, A0);
+    t.lw(T1, 12, A0);
+    bigEndianSwap(t, T0, T1);
+    t.expect(T0, 0x00000001);
+    t.expect(T1, 0x40080000);
+
+    // Each one counts as a single load or store
+    perfCountOne(t, PERF_EVENT_LOADS, true);
+    perfCountOne(t, PERF_EVENT_STORES, false);
+}
+
+struct Conformance {
+    const char *name;
+    void (*build)( Test &t );
+};
+
+const Conformance tests[] = {
+    { "beql", testBeql },
+    { "bnel", testBnel },
+    { "blezl", testBlezl },
+    { "bgtzl", testBgtzl },
+    { "likelyirq", testLikelyIrq },
+    { "tgei", testTgei },
+    { "tgeiu", testTgeiu },
+    { "tlti", testTlti },
+    { "tltiu", testTltiu },
+    { "teqi", testTeqi },
+    { "tnei", testTnei },
+    { "synci", testSynci },
+    { "pref", testPref },
+    { "movci", testMovci },
+    { "sdbbp", testSdbbp },
+    { "pgpr", testPgpr },
+    { "rdhwr", testRdhwr },
+    { "clz", testClz },
+    { "clo", testClo },
+    { "bc1l", testBc1l },
+    { "fpbranch", testFpBranch },
+    { "fpcompare", testFpCompare },
+    { "fparith", testFpArith },
+    { "fptrap", testFpTrap },
+    { "fpmemory", testFpMemory },
+};
+
+const size_t test_count = sizeof(tests)/sizeof(tests[0]);
+
+}
+
+int main( int argc, char **argv )
+{
+    static const enum Mode modes[] = { MODE_QUANTUM, MODE_DMI };
+    // Programs are short, anything longer is lost
+    const uint64_t max_cycles = 100000;
+
+    std::vector<const Conformance*> selected;
+    for ( int i = 1; i < argc; ++i ) {
+        size_t k;
+        for ( k = 0; k < test_count; ++k )
+            if ( ! std::strcmp(argv[i], tests[k].name) )
+                break;
+        if ( k == test_count ) {
+            std::fprintf(stderr, "unknown test %s, tests:", argv[i]);
+            for ( k = 0; k < test_count; ++k )
+                std::fprintf(stderr, " %s", tests[k].name);
+            std::fprintf(stderr, "\n");
+            return 1;
+        }
+        selected.push_back(&tests[k]);
+    }
+    if ( selected.empty() )
+        for ( size_t k = 0; k < test_count; ++k )
+            selected.push_back(&tests[k]);
+
+    FlatMemory mem;
+    size_t failed = 0;
+
+    for ( size_t k = 0; k < selected.size(); ++k ) {
+        Test t;
+        selected[k]->build( t );
+        std::vector<uint32_t> code = t.finish();
+
+        std::printf("%-10s", selected[k]->name);
+        for ( int big_endian = 0; big_endian < 2; ++big_endian ) {
+            for ( size_t m = 0; m < sizeof(modes)/sizeof(modes[0]); ++m ) {
+                Result r = run( code, modes[m], mem, big_endian, max_cycles );
+                std::printf(" %s/%s:", big_endian ? "eb" : "el", mode_names[modes[m]]);
+                if ( r.ok )
+                    std::printf("ok");
+                else if ( r.exited )
+                    std::printf("FAIL(check %u)", r.exit_code);
+                else
+                    std::printf("FAIL(no exit)");
+                failed += !r.ok;
+            }
+        }
+        std::printf("\n");
+    }
+
+    std::printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed != 0;
+}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
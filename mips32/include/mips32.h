@@ -44,9 +44,23 @@
 #include "iss2.h"
 #include "soclib_endian.h"
 #include "register.h"
+#include "iss2_trace.h"
+#include "mips32_profile.h"
+#include "mips32_timing.h"
+#include "mips32_observer.h"
+#ifdef MIPS32_OBSERVER_HEADER
+#include MIPS32_OBSERVER_HEADER
+#endif
 
 namespace soclib { namespace common {
 
+/**
+ * Mips32 core, specialized at compile time on its endianness and
+ * instrumentation policy (see Mips32NullObserver).
+ *
+ * Use Mips32ElIss or Mips32EbIss, or Mips32ObservedIss.
+ */
+template <bool little_endian, typename Observer = Mips32NullObserver>
 class Mips32Iss
     : public Iss2
 {
@@ -109,7 +123,13 @@ private:
     int r_mem_byte_le;
     int r_mem_byte_count;
     int r_mem_offset_byte_in_reg;
+    // General register, or FPU register + MEM_DEST_FPR
     uint32_t r_mem_dest;
+    // Second word of a 64-bit FPU access, issued from _setData()
+    bool r_mem_pair;
+    addr_t r_mem_pair_addr;
+    uint32_t r_mem_pair_dest;
+    data_t r_mem_pair_wdata;
 
 	data_t	m_rdata;
 	bool		m_ibe;
@@ -119,6 +139,12 @@ private:
 
     // Instruction latency simulation
     uint32_t m_ins_delay;
+    // Cycles until the multiply/divide unit has completed, see
+    // mduIssue()
+    uint32_t m_mdu_delay;
+    // State of the generator for unpredictable results, kept per
+    // core for deterministic runs
+    uint32_t m_random;
 
 
     typedef union {
@@ -152,6 +178,14 @@ private:
                     uint32_t zero2:2,
                     uint32_t sel:3
                     ) coproc;
+                PACKED_BITFIELD(
+                    uint32_t op:6,
+                    uint32_t fmt:5,
+                    uint32_t ft:5,
+                    uint32_t fs:5,
+                    uint32_t fd:5,
+                    uint32_t func:6
+                    ) f;
             } __attribute__((packed));
         } __attribute__((packed));
         uint32_t ins;
@@ -242,6 +276,17 @@ private:
         uint32_t fp:1,
         ) config1_t;
 
+    typedef REG32_BITFIELD(
+        uint32_t m:1,
+        uint32_t zero:20,
+        uint32_t event:6,
+        uint32_t ie:1,
+        uint32_t u:1,
+        uint32_t s:1,
+        uint32_t k:1,
+        uint32_t exl:1,
+        ) perfctl_t;
+
     typedef REG32_BITFIELD(
         uint32_t m:1,
         uint32_t k23:3,
@@ -286,6 +331,18 @@ private:
         uint32_t tl:1
         ) config3_t;
 
+    typedef REG32_BITFIELD(
+        uint32_t fcc:7,
+        uint32_t fs:1,
+        uint32_t fcc0:1,
+        uint32_t impl:2,
+        uint32_t zero:3,
+        uint32_t cause:6,
+        uint32_t enables:5,
+        uint32_t flags:5,
+        uint32_t rm:2,
+        ) fcsr_t;
+
     status_t r_status;
     cause_t r_cause;
     addr_t r_ebase;
@@ -296,6 +353,37 @@ private:
     uint32_t r_compare;
 
     bool m_sleeping;
+
+    // Spin loop detection, see setSpinDetection() and mips32_spin.cpp
+    enum {
+        SPIN_MAX_INS = 32,
+        SPIN_MAX_LOADS = 4,
+        SPIN_MAX_RANGES = 8,
+        SPIN_REGS = 32 + 2,
+    };
+    bool m_spin_detection;
+    // Memory a polling loop may read, see addSpinRange()
+    struct SpinRange {
+        addr_t base;
+        size_t size;
+    };
+    struct SpinRange m_spin_ranges[SPIN_MAX_RANGES];
+    size_t m_spin_range_count;
+    // Parked in a detected loop, like m_sleeping
+    bool m_spinning;
+    // A backward branch was taken, reaching its target ends the
+    // current iteration
+    bool m_spin_closing;
+    addr_t m_spin_target;
+    // Head of the current iteration, registers when it started, and
+    // whether the iteration only read memory so far
+    addr_t m_spin_head;
+    data_t m_spin_regs[SPIN_REGS];
+    bool m_spin_clean;
+    uint32_t m_spin_ins;
+    uint32_t m_spin_loads;
+    addr_t m_spin_load_addr[SPIN_MAX_LOADS];
+    uint32_t m_spin_cycles;
     
     // member variables used for communication between
     // member functions (they are not registers)
@@ -314,13 +402,61 @@ private:
     uint32_t r_hwrena;
     uint32_t r_tls_base;
 
-    const bool m_little_endian;
+    // FPU registers, see mips32_cop1.cpp. Status.FR is hardwired to
+    // 0, doubles live in even/odd pairs, low word in the even one.
+    uint32_t r_fpr[32];
+    fcsr_t r_fcsr;
+
+    enum {
+        MEM_DEST_FPR = 32,
+    };
+
+    // FCSR cause, enable and flag bits
+    enum FpException {
+        FP_I = 0x01,    // Inexact
+        FP_U = 0x02,    // Underflow
+        FP_O = 0x04,    // Overflow
+        FP_Z = 0x08,    // Division by zero
+        FP_V = 0x10,    // Invalid operation
+        FP_E = 0x20,    // Unimplemented operation, cause only
+    };
+
+    // Coprocessor number reported in Cause.CE on X_CPU
+    uint32_t m_unusable_cop;
+
+    // Performance counters, PerfCtl/PerfCnt pairs in CP0 register 25
+    enum {
+        PERF_COUNTERS = 2,
+    };
+
+    enum PerfEvent {
+        PERF_CYCLES,
+        PERF_INSTRUCTIONS,
+        PERF_LOADS,
+        PERF_STORES,
+        PERF_BRANCHES_TAKEN,
+        PERF_HAZARD_STALLS,
+        PERF_MDU_STALLS,
+        PERF_IFETCH_STALLS,
+        PERF_DFETCH_STALLS,
+    };
+
+    perfctl_t r_perfctl[PERF_COUNTERS];
+    uint32_t r_perfcnt[PERF_COUNTERS];
+    // Some counter is enabled in some mode
+    bool m_perf_active;
 
     bool m_ireq_ok;
     bool m_dreq_ok;
 
+    bool m_block_execution;
+    bool m_jit_enabled;
+    // No stall modelling, see setFunctional()
+    bool m_functional;
+
 public:
-    Mips32Iss(const std::string &name, uint32_t ident, bool default_little_endian);
+    Mips32Iss(const std::string &name, uint32_t ident);
+    ~Mips32Iss();
 
     void dump() const;
 
@@ -330,13 +466,25 @@ public:
         const struct DataResponse &drsp,
         uint32_t irq_bit_field );
 
+    uint32_t executeQuantum(
+        uint32_t quantum,
+        LtMemory &mem,
+        uint32_t irq_bit_field );
+
+    uint32_t nextEventDelay( uint32_t irq_bit_field ) const;
+
+    bool stateSave( std::ostream &o ) const;
+    bool stateRestore( std::istream &i );
+
 	inline void getRequests( struct InstructionRequest &ireq,
                              struct DataRequest &dreq ) const
 	{
-        ireq.valid = !m_sleeping;
+        ireq.valid = !m_sleeping && !m_spinning && !dmiPtr( r_pc, DMI_READ );
 		ireq.addr = r_pc;
         ireq.mode = r_bus_mode;
         dreq = m_dreq;
+        if ( m_dmi_dreq )
+            dreq.valid = false;
 	}
 
 	inline void setWriteBerr()
@@ -348,6 +496,7 @@ public:
 
     // processor internal registers access API, used by
     // debugger. Mips32 order is 32 general-purpose; sr; lo; hi; bad; cause; pc;
+    // 32 floating-point; fcsr; fir;
 
     // CDB method's
 #ifdef CDB_COMPONENT_IF_H
@@ -359,7 +508,7 @@ public:
 
     inline unsigned int debugGetRegisterCount() const
     {
-        return 32 + 6;
+        return 32 + 6 + 32 + 2;
     }
 
     virtual debug_register_t debugGetRegisterValue(unsigned int reg) const;
@@ -380,15 +529,267 @@ public:
     void setICacheInfo( size_t line_size, size_t assoc, size_t n_lines );
     void setDCacheInfo( size_t line_size, size_t assoc, size_t n_lines );
 
+    /**
+     * When enabled, executeNCycles() goes on executing the following
+     * instructions from the predecoded instruction cache, without
+     * fetching them through the wrapper, until ncycle cycles are
+     * spent, a data access is issued, the core sleeps or the next
+     * instruction is not predecoded.
+     *
+     * Architectural behaviour is unchanged, but instruction fetch
+     * timing is not simulated for those instructions and fetch-based
+     * debuggers will not see them. Only useful if the wrapper calls
+     * executeNCycles() with ncycle > 1.
+     */
+    inline void setBlockExecution( bool enabled )
+    {
+        m_block_execution = enabled;
+    }
+
+    /**
+     * When enabled together with block execution, hot straight-line
+     * sequences of integer ALU instructions are translated to host
+     * code and run natively. Only available on x86-64 hosts, this is
+     * a no-op elsewhere. Translations are dropped whenever the core
+     * writes to translated code or flushes/invalidates its
+     * instruction cache.
+     */
+    inline void setJit( bool enabled )
+    {
+        m_jit_enabled = enabled;
+    }
+
+    /**
+     * Select External Interrupt Controller mode (advertised in
+     * Config3.VEIC). Irq lines are then taken as the 6-bit requested
+     * interrupt priority level of the controller, compared with
+     * Status.IPL, and used as vector number. The internal timer
+     * interrupt is not routed to the core anymore in this mode.
+     */
+    inline void setEic( bool enabled )
+    {
+        r_config3.veic = enabled;
+    }
+
+    /**
+     * Functional mode: multi-cycle MDU and FPU operations and load-use
+     * hazards are not modelled anymore, every instruction retires in
+     * one cycle (memory latencies are still the wrapper's). Meant to
+     * fast-forward up to a region of interest.
+     *
+     * Software can switch modes as well, writing the implementation
+     * dependant CP0 register 9, select 7 (non-zero enters functional
+     * mode, zero goes back to timing mode), e.g. as a marker at the
+     * start of the region of interest. Use isFunctional() to notice.
+     */
+    inline void setFunctional( bool enabled )
+    {
+        m_functional = enabled;
+        if ( enabled ) {
+            m_ins_delay = 0;
+            m_mdu_delay = 0;
+            m_hazard = false;
+        }
+    }
+
+    inline bool isFunctional() const
+    {
+        return m_functional;
+    }
+
+    /**
+     * Cycles elapsed and instructions retired (CP0 9,6), both
+     * wrapping. Unlike CP0 Count, the cycle count is never written by
+     * software, so deltas of it are always meaningful.
+     */
+    inline uint32_t cycleCount() const
+    {
+        return (uint32_t)m_cycles;
+    }
+
+    inline uint32_t retiredCount() const
+    {
+        return m_exec_cycles;
+    }
+
+    /**
+     * Attach a per-PC execution profile, or detach it with NULL.
+     * Nothing is recorded, and nearly nothing is spent, while no
+     * profile is attached. Cycles spent sleeping are not recorded.
+     */
+    void setProfile( Mips32Profile *profile );
+
+    /**
+     * Attach a retired instruction trace, or detach it with NULL.
+     * Instructions run as translated code are not traced, so
+     * translation is suspended while a trace is attached.
+     */
+    void setTrace( Iss2TraceWriter *trace );
+
+    /**
+     * Attach a timing model, or detach it with NULL to go back to the
+     * built-in latencies. While a model is attached, it decides of
+     * all the stalls between instructions, the built-in load-use,
+     * multiply/divide and FPU latencies are disabled, and code is not
+     * translated. The model is reset on attach, core reset and state
+     * restore. Memory latencies are still the wrapper's.
+     */
+    void setTiming( Mips32TimingModel *timing );
+
+    /**
+     * Detect polling loops and park the core in them, as if it
+     * executed WAIT, instead of running them again and again.
+     *
+     * A loop is detected when an iteration, ending on a taken
+     * backward branch or jump, only read memory, did not use any
+     * coprocessor, and left the general registers, hi and lo as they
+     * were when it started. As long as the memory it read does not
+     * change, it would run the same forever. The core then waits for
+     * an irq it may take, or a snoopWrite() to a word the iteration
+     * read, and goes on with the loop. Skipped cycles are counted as
+     * usual, see spinCycles().
+     *
+     * Only loads from memory are accepted in a polling loop, i.e.
+     * from DMI grants or from ranges declared with addSpinRange().
+     * Any other load, typically a device register (uart status, DMA
+     * done bits, free-running timers) whose value changes without a
+     * bus write, disqualifies the iteration.
+     *
+     * Platforms must report all the writes other masters and devices
+     * do to these ranges with snoopWrite() before enabling this.
+     * Loops run as translated code are not detected.
+     */
+    void setSpinDetection( bool enabled );
+
+    /**
+     * Declare [base, base+size) as plain memory a polling loop may
+     * read, in addition to DMI grants. Addresses are the ones of the
+     * data requests. Returns false if no more range can be declared.
+     */
+    bool addSpinRange( addr_t base, size_t size );
+
+    inline Observer &observer()
+    {
+        return m_observer;
+    }
+
+    void snoopWrite( addr_t base, size_t size );
+
+    /**
+     * Cycles spent parked in detected loops, wrapping.
+     */
+    inline uint32_t spinCycles() const
+    {
+        return m_spin_cycles;
+    }
+
+    bool dmiGrant( addr_t base, size_t size, uint8_t *host_ptr, int access );
+    void dmiRevoke( addr_t base, size_t size );
+
 private:
     void run();
+    void executeInstruction( uint32_t irq_bit_field );
+    uint32_t executeBlock( uint32_t ncycle, uint32_t irq_bit_field );
 
     void _setData(const struct DataResponse &rsp);
+    void setDestData( data_t rdata );
+
+    bool spinCheck();
+    void spinRetire();
+    void spinForget();
+    bool spinMayLoad( addr_t addr ) const;
+
+    // xorshift32
+    inline uint32_t unpredictable()
+    {
+        m_random ^= m_random << 13;
+        m_random ^= m_random >> 17;
+        m_random ^= m_random << 5;
+        return m_random;
+    }
+
+    // Built-in instruction latencies apply: neither in functional
+    // mode nor driven by a timing model
+    inline bool builtinTiming() const
+    {
+        return ! m_functional && ! m_timing;
+    }
 
     inline void setInsDelay( uint32_t delay )
     {
         assert( delay > 0 );
-        m_ins_delay = delay-1;
+        if ( builtinTiming() )
+            m_ins_delay = delay-1;
+    }
+
+    // Multiply/divide operations run in the background, the core
+    // only stalls on an instruction reading or writing hi/lo while an
+    // operation is in progress. The stall is charged to that
+    // instruction, freezing the core after it, like setInsDelay().
+    inline uint32_t mduWait()
+    {
+        uint32_t wait = m_mdu_delay;
+        if ( wait )
+            setInsDelay( wait + 1 );
+        return wait;
+    }
+
+    // Waits for the previous operation, then keeps the unit busy for
+    // `latency' cycles
+    inline void mduIssue( uint32_t latency )
+    {
+        uint32_t wait = mduWait();
+        if ( builtinTiming() )
+            m_mdu_delay = wait + latency;
+    }
+
+    // Count goes on for n cycles, Cause.TI is raised if it reaches
+    // Compare meanwhile.
+    inline void addCount( uint32_t n )
+    {
+        if ( r_compare - r_count - 1 < n )
+            r_cause.ti = 1;
+        r_count += n;
+        m_cycles += n;
+        m_mdu_delay = m_mdu_delay > n ? m_mdu_delay - n : 0;
+        perfCount( PERF_CYCLES, n );
+    }
+
+    // Irq lines as seen by the core, timer and performance counter
+    // interrupts included. In EIC mode, lines carry the requested
+    // priority level of the controller, which is in charge of the
+    // internal interrupts.
+    inline uint32_t irqLines( uint32_t irq_bit_field ) const
+    {
+        if ( r_config3.veic )
+            return irq_bit_field;
+        if ( r_cause.ti )
+            irq_bit_field |= 1 << (r_intctl.ipti - 2);
+        if ( r_cause.pci )
+            irq_bit_field |= 1 << (r_intctl.ippci - 2);
+        return irq_bit_field;
+    }
+
+    void perfEvent( enum PerfEvent event, uint32_t n );
+    void perfUpdate();
+    bool perfCounting( const perfctl_t &ctl ) const;
+    uint32_t perfOverflowDelay() const;
+
+    inline void perfCount( enum PerfEvent event, uint32_t n = 1 )
+    {
+        if ( m_perf_active )
+            perfEvent( event, n );
+    }
+
+    // Whether an interrupt is requested and not masked by Status.IM
+    // (or above Status.IPL in EIC mode). Status.IE/EXL/ERL are left
+    // to the caller.
+    inline bool irqPending( uint32_t irq_bit_field ) const
+    {
+        uint32_t lines = irqLines( irq_bit_field );
+        if ( r_config3.veic )
+            return (lines & 0x3f) > (r_status.im>>2);
+        return (r_status.im>>2) & lines;
     }
 
     addr_t exceptOffsetAddr( enum ExceptCause cause ) const;
@@ -413,6 +814,8 @@ private:
 
     static func_t const opcod_table[64];
     static func_t const special_table[64];
+    static func_t const special2_table[64];
+    static func_t const special3_table[64];
 
 
     void do_mem_access( addr_t address,
@@ -442,6 +845,8 @@ private:
     void op_xori();
     void op_lui();
     void op_cop0();
+    void op_cop1();
+    void op_cop1x();
     void op_cop2();
     void op_beql();
     void op_bnel();
@@ -463,6 +868,11 @@ private:
     void op_swr();
     void op_sc();
     void op_cache();
+    void op_pref();
+    void op_lwc1();
+    void op_ldc1();
+    void op_swc1();
+    void op_sdc1();
 
     void special_sll();
     void special_srl();
@@ -495,6 +905,7 @@ private:
     void special_nor();
     void special_slt();
     void special_sltu();
+    void special_movci();
     void special_ill();
 
     void special_tlt();
@@ -504,6 +915,70 @@ private:
     void special_teq();
     void special_tne();
 
+    void special2_madd();
+    void special2_maddu();
+    void special2_mul();
+    void special2_msub();
+    void special2_msubu();
+    void special2_clz();
+    void special2_clo();
+    void special2_sdbbp();
+    void special2_ill();
+
+    void special3_ext();
+    void special3_ins();
+    void special3_bshfl();
+    void special3_rdhwr();
+    void special3_ill();
+
+    // FPU, see mips32_cop1.cpp
+    bool fpuUsable();
+    void fpuBegin( int host_rounding );
+    bool fpuEnd( uint32_t cause );
+    bool fpuRaise( uint32_t cause );
+    void fpuUnimplemented();
+    void fpuBranch();
+    void fpuArithW();
+    template <typename F> void fpuArith();
+    void fpuLoadWord( addr_t address, uint32_t ft );
+    void fpuLoadDouble( addr_t address, uint32_t ft );
+    void fpuStoreWord( addr_t address, uint32_t ft );
+    void fpuStoreDouble( addr_t address, uint32_t ft );
+
+    // FIR: single, double and word formats
+    static inline uint32_t fpuFir()
+    {
+        return 0x00130000;
+    }
+
+    inline bool fpuCondition( uint32_t cc ) const
+    {
+        if ( cc == 0 )
+            return r_fcsr.fcc0;
+        return (r_fcsr.fcc >> (cc - 1)) & 1;
+    }
+
+    inline void fpuSetCondition( uint32_t cc, bool v )
+    {
+        if ( cc == 0 )
+            r_fcsr.fcc0 = v;
+        else
+            r_fcsr.fcc = (r_fcsr.fcc & ~(1 << (cc - 1))) | (v << (cc - 1));
+    }
+
+    inline uint64_t fpuGetDouble( uint32_t reg ) const
+    {
+        reg &= ~1;
+        return ((uint64_t)r_fpr[reg+1] << 32) | r_fpr[reg];
+    }
+
+    inline void fpuSetDouble( uint32_t reg, uint64_t v )
+    {
+        reg &= ~1;
+        r_fpr[reg] = v;
+        r_fpr[reg+1] = v >> 32;
+    }
+
     typedef enum {
         USE_NONE = 0,
         USE_T    = 1,
@@ -512,12 +987,161 @@ private:
         USE_SPECIAL = 4,
     } use_t;
 
-    use_t curInstructionUsesRegs();
-
     static const char* name_table[64];
     static use_t const use_table[64];
     static use_t const use_special_table[64];
 
+    // Predecoded instruction cache, indexed by PC. An entry is only
+    // reused if both its PC and its instruction word match, so it
+    // never returns a stale decoding for a fetched instruction.
+    struct DecodedIns {
+        addr_t pc;
+        uint32_t ins;
+        func_t func;
+        use_t use;
+    };
+
+    enum {
+        DECODE_CACHE_SIZE = 1024,
+        DECODE_INVALID_PC = 1,
+    };
+
+    struct DecodedIns m_decode_cache[DECODE_CACHE_SIZE];
+    const struct DecodedIns *m_decoded;
+    size_t m_icache_line_size;
+
+    void decodeIns( struct DecodedIns &d, addr_t pc, uint32_t ins ) const;
+
+    inline const struct DecodedIns *decode( addr_t pc, uint32_t ins )
+    {
+        struct DecodedIns &d = m_decode_cache[(pc>>2)%DECODE_CACHE_SIZE];
+        if ( d.pc != pc || d.ins != ins ) {
+            // Code changed behind our back
+            if ( d.pc == pc )
+                jitInval( pc );
+            decodeIns( d, pc, ins );
+        }
+        return &d;
+    }
+
+    inline void decodeCacheInval( addr_t addr )
+    {
+        struct DecodedIns &d = m_decode_cache[(addr>>2)%DECODE_CACHE_SIZE];
+        if ( d.pc == (addr & ~(addr_t)3) )
+            d.pc = DECODE_INVALID_PC;
+        jitInval( addr );
+    }
+
+    void decodeCacheInvalLine( addr_t addr );
+    void decodeCacheFlush();
+
+    inline use_t curInstructionUsesRegs() const
+    {
+        return m_decoded->use;
+    }
+
+    // Translated blocks, see mips32_jit.cpp. Blocks are looked up by
+    // PC, only at block heads, and only translated after
+    // JIT_THRESHOLD executions. `hits' of a translated block counts
+    // its uses, aged by the misses in its set.
+    typedef void (*jit_func_t)( data_t *gp );
+
+    struct JitBlock {
+        addr_t pc;
+        uint32_t hits;
+        uint32_t n_ins;
+        jit_func_t code;
+    };
+
+    enum {
+        JIT_CACHE_SETS = 512,
+        JIT_CACHE_WAYS = 2,
+        JIT_THRESHOLD = 32,
+        JIT_MAX_INS = 64,
+        JIT_CODE_SIZE = 256*1024,
+    };
+
+    struct JitBlock m_jit_cache[JIT_CACHE_SETS][JIT_CACHE_WAYS];
+    uint8_t *m_jit_code;
+    size_t m_jit_code_used;
+    // Current PC was reached by a control transfer
+    bool m_jit_head;
+    // Address range covered by all translations, for invalidation
+    addr_t m_jit_lo;
+    addr_t m_jit_hi;
+
+    struct JitBlock *jitLookup( addr_t pc );
+    uint32_t jitExecute( uint32_t ncycle, uint32_t irq_bit_field );
+    bool jitTranslate( struct JitBlock &b );
+    void jitFlush();
+    void jitRelease();
+
+    inline void jitInval( addr_t addr )
+    {
+        if ( addr - m_jit_lo < m_jit_hi - m_jit_lo )
+            jitFlush();
+    }
+
+    // Direct memory interface grants, see Iss2::dmiGrant()
+    struct DmiRegion {
+        addr_t base;
+        size_t size;
+        uint8_t *host_ptr;
+        int access;
+    };
+
+    enum {
+        DMI_MAX_REGIONS = 8,
+    };
+
+    struct DmiRegion m_dmi[DMI_MAX_REGIONS];
+    size_t m_dmi_count;
+    // Current data access was performed through DMI, m_dmi_drsp
+    // holds its response
+    bool m_dmi_dreq;
+    struct DataResponse m_dmi_drsp;
+
+    inline uint8_t *dmiPtr( addr_t addr, int access ) const
+    {
+        for ( size_t i = 0; i < m_dmi_count; ++i ) {
+            const struct DmiRegion &r = m_dmi[i];
+            if ( (r.access & access) && (size_t)(addr - r.base) <= r.size - 4 )
+                return r.host_ptr + (addr - r.base);
+        }
+        return NULL;
+    }
+
+    static inline data_t dmiLoad( const uint8_t *p )
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((data_t)p[3] << 24);
+    }
+
+    inline bool dmiFetch( addr_t addr, data_t &ins ) const
+    {
+        const uint8_t *p = dmiPtr( addr, DMI_READ );
+        if ( ! p )
+            return false;
+        ins = dmiLoad( p );
+        return true;
+    }
+
+    void dmiAccess();
+
+    Mips32Profile *m_profile;
+    Iss2TraceWriter *m_trace;
+    Observer m_observer;
+    Mips32TimingModel *m_timing;
+    // Time base of m_timing and cycleCount(), unlike Count it is
+    // never written. 64-bit, so that m_timing never sees it wrap.
+    uint64_t m_cycles;
+
+    // Checkpointing, see mips32_state.cpp
+    enum {
+        STATE_VERSION = 5,
+    };
+
+    template <typename Archive> void stateTransfer( Archive &a );
+
     bool isCopAccessible(int) const;
     uint32_t cp0Get( uint32_t reg, uint32_t sel ) const;
     void cp0Set( uint32_t reg, uint32_t sel, uint32_t value );
@@ -529,31 +1153,88 @@ private:
 };
 
 class Mips32ElIss
-    : public Mips32Iss
+    : public Mips32Iss<true>
 {
 public:
     static const Iss2::debugCpuEndianness s_endianness = Iss2::ISS_LITTLE_ENDIAN;
 
     Mips32ElIss(const std::string &name, uint32_t ident)
-        : Mips32Iss(name, ident, true)
+        : Mips32Iss<true>(name, ident)
     {}
 
     void please_instanciate_Mips32ElIss_or_Mips32EbIss() {}
 };
 
 class Mips32EbIss
-    : public Mips32Iss
+    : public Mips32Iss<false>
 {
 public:
     static const Iss2::debugCpuEndianness s_endianness = Iss2::ISS_BIG_ENDIAN;
 
     Mips32EbIss(const std::string &name, uint32_t ident)
-        : Mips32Iss(name, ident, false)
+        : Mips32Iss<false>(name, ident)
+    {}
+
+    void please_instanciate_Mips32ElIss_or_Mips32EbIss() {}
+};
+
+/**
+ * Mips32 core reporting its activity to an `Observer', see
+ * Mips32NullObserver.
+ *
+ * The core must be instantiated for the observer: build the mips32
+ * implementation files with MIPS32_OBSERVER_HEADER defined to the
+ * header declaring the observer class (e.g. '"my_observer.h"'), and
+ * MIPS32_OBSERVER to its name.
+ */
+template <bool little_endian, typename Observer>
+class Mips32ObservedIss
+    : public Mips32Iss<little_endian, Observer>
+{
+public:
+    static const Iss2::debugCpuEndianness s_endianness =
+        little_endian ? Iss2::ISS_LITTLE_ENDIAN : Iss2::ISS_BIG_ENDIAN;
+
+    Mips32ObservedIss(const std::string &name, uint32_t ident)
+        : Mips32Iss<little_endian, Observer>(name, ident)
     {}
 
     void please_instanciate_Mips32ElIss_or_Mips32EbIss() {}
 };
 
+/*
+ * Out of line members of Mips32Iss are explicitly instantiated by the
+ * implementation file defining them, for each core specialization, so
+ * that no specialization is instantiated twice in the program:
+ *
+ *   MIPS32_INSTANTIATE(void, reset())
+ *   MIPS32_INSTANTIATE_NESTED(func_t const, opcod_table[64])
+ *
+ * The _NESTED flavour is for types declared in Mips32Iss.
+ */
+#ifdef MIPS32_OBSERVER
+#define MIPS32_INSTANTIATE_OBSERVED(type, ...)                          \
+    template type Mips32Iss<true, MIPS32_OBSERVER>::__VA_ARGS__;        \
+    template type Mips32Iss<false, MIPS32_OBSERVER>::__VA_ARGS__;
+#define MIPS32_INSTANTIATE_OBSERVED_NESTED(type, ...)                   \
+    template Mips32Iss<true, MIPS32_OBSERVER>::type                     \
+        Mips32Iss<true, MIPS32_OBSERVER>::__VA_ARGS__;                  \
+    template Mips32Iss<false, MIPS32_OBSERVER>::type                    \
+        Mips32Iss<false, MIPS32_OBSERVER>::__VA_ARGS__;
+#else
+#define MIPS32_INSTANTIATE_OBSERVED(type, ...)
+#define MIPS32_INSTANTIATE_OBSERVED_NESTED(type, ...)
+#endif
+
+#define MIPS32_INSTANTIATE(type, ...)                                   \
+    template type Mips32Iss<true>::__VA_ARGS__;                         \
+    template type Mips32Iss<false>::__VA_ARGS__;                        \
+    MIPS32_INSTANTIATE_OBSERVED(type, __VA_ARGS__)
+#define MIPS32_INSTANTIATE_NESTED(type, ...)                            \
+    template Mips32Iss<true>::type Mips32Iss<true>::__VA_ARGS__;        \
+    template Mips32Iss<false>::type Mips32Iss<false>::__VA_ARGS__;      \
+    MIPS32_INSTANTIATE_OBSERVED_NESTED(type, __VA_ARGS__)
+
 }}
 
 #endif // _SOCLIB_MIPS32_ISS_H_
@@ -0,0 +1,109 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#ifndef _SOCLIB_MIPS32_OBSERVER_H_
+#define _SOCLIB_MIPS32_OBSERVER_H_
+
+#include "iss2.h"
+
+namespace soclib { namespace common {
+
+/**
+ * Compile-time instrumentation policy of Mips32Iss, see
+ * Mips32ObservedIss. This default one does nothing, and is compiled
+ * away.
+ *
+ * Observers provide all the hooks below, usually by inheriting this
+ * class and hiding the ones they need. Each core embeds its own
+ * observer instance, see Mips32Iss::observer(). Hooks are called from
+ * the simulation thread, and must not modify the core state.
+ */
+class Mips32NullObserver
+{
+public:
+    typedef Iss2::addr_t addr_t;
+
+    // Instructions run as translated code are not retired one by
+    // one, observers of onRetire() should forbid translation.
+    static const bool s_allow_jit = true;
+
+    /**
+     * Instruction at `pc' retired, `mode' is the mode it ran in.
+     */
+    inline void onRetire( addr_t pc, uint32_t ins, enum Iss2::ExecMode mode )
+    {}
+
+    /**
+     * Instruction at `pc' raised exception `cause' (Cause.ExcCode),
+     * handled at `vector'.
+     */
+    inline void onException( uint32_t cause, addr_t pc, addr_t vector )
+    {}
+
+    /**
+     * Interrupt taken after the instruction at `pc', `irq_lines'
+     * being the ones seen by the core (Cause.IP7-2), handled at
+     * `vector'.
+     */
+    inline void onIrqTaken( uint32_t irq_lines, addr_t pc, addr_t vector )
+    {}
+
+    /**
+     * Data access issued, either to the wrapper or through DMI.
+     */
+    inline void onMemRequest( const struct Iss2::DataRequest &req )
+    {}
+
+    /**
+     * Data access completed.
+     */
+    inline void onMemResponse( const struct Iss2::DataRequest &req,
+                               const struct Iss2::DataResponse &rsp )
+    {}
+
+    /**
+     * Mode of the instruction fetches and data accesses changed.
+     */
+    inline void onModeChange( enum Iss2::ExecMode from, enum Iss2::ExecMode to )
+    {}
+};
+
+}}
+
+#endif // _SOCLIB_MIPS32_OBSERVER_H_
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
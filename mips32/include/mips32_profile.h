@@ -0,0 +1,145 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#ifndef _SOCLIB_MIPS32_PROFILE_H_
+#define _SOCLIB_MIPS32_PROFILE_H_
+
+#include <inttypes.h>
+#include <iostream>
+#include <map>
+
+namespace soclib { namespace common {
+
+/**
+ * Per-PC cycle histogram of a Mips32 core, see
+ * Mips32Iss::setProfile().
+ *
+ * Each cycle is charged to the PC of the instruction being executed
+ * or waited for, with the reason it was spent. Counting is either
+ * exact, or sampled every `period' cycles, each sample being charged
+ * the whole period.
+ */
+class Mips32Profile
+{
+public:
+    typedef uint32_t addr_t;
+
+    enum Event {
+        EXECUTED,       // Instruction issued
+        INS_DELAY,      // Multi-cycle instruction latency
+        HAZARD,         // Load-use hazard
+        IFETCH,         // Waiting for instruction fetch
+        DFETCH,         // Waiting for a data access
+        EVENT_COUNT,
+    };
+
+    Mips32Profile( uint32_t period = 1 );
+    ~Mips32Profile();
+
+    /**
+     * Sampling period in cycles, 1 for exact counting.
+     */
+    void setPeriod( uint32_t period );
+
+    inline void record( addr_t pc, enum Event event, uint32_t cycles )
+    {
+        if ( m_period == 1 ) {
+            add( pc, event, cycles );
+            return;
+        }
+        while ( cycles >= m_countdown ) {
+            cycles -= m_countdown;
+            add( pc, event, m_period );
+            m_countdown = m_period;
+        }
+        m_countdown -= cycles;
+    }
+
+    void clear();
+
+    /**
+     * Text dump, one line per PC: address, then counts for each
+     * event, in enum Event order.
+     */
+    void dumpText( std::ostream &o ) const;
+
+    /**
+     * gmon.out histogram of all the cycles spent at each PC, for use
+     * with the target gprof. Counts are scaled down to fit the 16-bit
+     * bins, the reported time unit being one million cycles.
+     */
+    void dumpGmon( std::ostream &o, bool big_endian ) const;
+
+private:
+    enum {
+        PAGE_SHIFT = 12,
+        PAGE_INS = 1 << (PAGE_SHIFT-2),
+    };
+
+    struct Page {
+        uint64_t count[EVENT_COUNT][PAGE_INS];
+    };
+
+    typedef std::map<addr_t, struct Page *> page_map_t;
+
+    page_map_t m_pages;
+    addr_t m_last_page;
+    struct Page *m_last;
+    uint32_t m_period;
+    uint32_t m_countdown;
+
+    struct Page *page( addr_t page_no );
+
+    inline void add( addr_t pc, enum Event event, uint64_t n )
+    {
+        addr_t page_no = pc >> PAGE_SHIFT;
+        if ( ! m_last || page_no != m_last_page ) {
+            m_last = page( page_no );
+            m_last_page = page_no;
+        }
+        m_last->count[event][(pc >> 2) & (PAGE_INS-1)] += n;
+    }
+
+    Mips32Profile( const Mips32Profile & );
+    Mips32Profile &operator=( const Mips32Profile & );
+};
+
+}}
+
+#endif // _SOCLIB_MIPS32_PROFILE_H_
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,151 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#ifndef _SOCLIB_MIPS32_SAMPLER_H_
+#define _SOCLIB_MIPS32_SAMPLER_H_
+
+#include "mips32.h"
+
+namespace soclib { namespace common {
+
+/**
+ * Statistical sampling driver (SMARTS-like) for a Mips32 core.
+ *
+ * Execution is split in periods of `period' retired instructions.
+ * Most of each period is fast-forwarded in functional mode, through
+ * the core's loosely-timed executeQuantum(). The last `warmup' +
+ * `window' instructions of each period run in timing mode, fetching
+ * every instruction through the memory. Warm-up lets the pipeline
+ * and memory state settle, then the CPI of the window, from the
+ * core's cycleCount() over retired instructions, is taken as one
+ * sample.
+ *
+ * All phases, windows included, run through executeQuantum() over
+ * `mem', not through the platform's cache wrappers. The sampled CPI
+ * only reflects the core stalls and the latencies `mem' returns, so
+ * `mem' has to model the memory hierarchy for it to be meaningful.
+ * Each quantum is clamped to the instructions left in the phase,
+ * which runs about as long as asked, one memory access latency at
+ * most over it.
+ */
+template<bool little_endian>
+class Mips32Sampler
+{
+public:
+    typedef Mips32Iss<little_endian> iss_t;
+
+    Mips32Sampler( iss_t &iss,
+                   Iss2::LtMemory &mem,
+                   uint32_t period = 1000000,
+                   uint32_t warmup = 2000,
+                   uint32_t window = 1000,
+                   uint32_t quantum = 1000 );
+
+    /**
+     * Run the core for at least `ninstructions' retired instructions,
+     * less if it goes asleep with no wake-up event pending. Returns
+     * the count of instructions retired. The core is left in timing
+     * mode.
+     */
+    uint64_t run( uint64_t ninstructions, uint32_t irq_bit_field = 0 );
+
+    /**
+     * Forget the samples taken so far.
+     */
+    void clear();
+
+    inline size_t samples() const
+    {
+        return m_samples;
+    }
+
+    inline uint64_t instructions() const
+    {
+        return m_instructions;
+    }
+
+    /**
+     * Mean sampled CPI.
+     */
+    inline double cpi() const
+    {
+        return m_mean;
+    }
+
+    /**
+     * Half-width of the confidence interval of cpi(), `z' being the
+     * normal quantile for the wanted confidence (3.0 is 99.7%).
+     */
+    double cpiError( double z = 3.0 ) const;
+
+    void report( std::ostream &o, double z = 3.0 ) const;
+
+private:
+    enum Phase {
+        FAST_FORWARD,
+        WARMUP,
+        WINDOW,
+    };
+
+    iss_t &m_iss;
+    Iss2::LtMemory &m_mem;
+    const uint32_t m_period;
+    const uint32_t m_warmup;
+    const uint32_t m_window;
+    const uint32_t m_quantum;
+
+    enum Phase m_phase;
+    // Instructions left in the current phase
+    uint32_t m_left;
+    uint32_t m_window_cycles;
+    uint32_t m_window_retired;
+
+    uint64_t m_instructions;
+    size_t m_samples;
+    // Welford's running mean and sum of squared deviations
+    double m_mean;
+    double m_m2;
+
+    void enterPhase( enum Phase phase );
+    void addSample( double cpi );
+};
+
+}}
+
+#endif /* _SOCLIB_MIPS32_SAMPLER_H_ */
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,227 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#ifndef _SOCLIB_MIPS32_TIMING_H_
+#define _SOCLIB_MIPS32_TIMING_H_
+
+#include <inttypes.h>
+#include <iostream>
+
+namespace soclib { namespace common {
+
+/**
+ * Mips32 core timing model, see Mips32Iss::setTiming().
+ *
+ * The core tells the model about each instruction it retires, at the
+ * cycle it executes it, memory latencies included. The model returns
+ * the number of stall cycles the instruction must wait before it may
+ * issue, which the core charges right after it.
+ */
+class Mips32TimingModel
+{
+public:
+    typedef uint32_t addr_t;
+
+    virtual ~Mips32TimingModel();
+
+    /**
+     * Forget about the instructions in flight.
+     */
+    virtual void reset() = 0;
+
+    /**
+     * `ins' is the instruction word, in host order. `taken' tells
+     * whether the instruction redirected the flow (taken branch,
+     * jump, eret). `now' is the cycle count, it never wraps.
+     */
+    virtual uint32_t issue( addr_t pc, uint32_t ins, bool taken, uint64_t now ) = 0;
+};
+
+/**
+ * Classic 5-stage in-order pipeline (IF, ID, EX, MEM, WB), modelled
+ * with a register scoreboard.
+ *
+ * Instructions are predecoded into operation classes and the
+ * registers they read and write. An instruction issues to EX once
+ * all its source registers are available, and its results are
+ * available to the following ones after the latency of its class.
+ * Latencies assume full forwarding, and are raised to what the
+ * register file provides when EX->EX or MEM->EX forwarding is
+ * disabled. Store data is needed at MEM only, one cycle later than
+ * other operands.
+ *
+ * Multiply/divide and FPU divide/square root operations also occupy
+ * their unit for the repeat rate of their class.
+ *
+ * FPU registers are tracked per even/odd pair.
+ */
+class Mips32PipelineModel
+    : public Mips32TimingModel
+{
+public:
+    enum OpClass {
+        OP_ALU,         // Integer operations, cop0 moves
+        OP_LOAD,        // Loads, sc, cop2 reads
+        OP_STORE,       // Stores
+        OP_BRANCH,      // Branches and jumps
+        OP_MFHILO,      // mfhi, mflo
+        OP_MTHILO,      // mthi, mtlo
+        OP_MULT,        // mult, multu
+        OP_MUL,         // mul
+        OP_MADD,        // madd, maddu, msub, msubu
+        OP_DIV,         // div, divu
+        OP_FP_MOVE,     // FPU moves, mov, movcf, movz, movn
+        OP_FP_ADD,      // add, sub, abs, neg
+        OP_FP_MUL,      // mul
+        OP_FP_MADD,     // madd, msub, nmadd, nmsub
+        OP_FP_CVT,      // cvt, round, trunc, ceil, floor
+        OP_FP_CMP,      // c.cond
+        OP_FP_DIV_S,    // div.s, recip.s
+        OP_FP_DIV_D,    // div.d, recip.d
+        OP_FP_SQRT_S,   // sqrt.s, rsqrt.s
+        OP_FP_SQRT_D,   // sqrt.d, rsqrt.d
+        OP_OTHER,       // Everything else
+        OP_CLASS_COUNT,
+    };
+
+    Mips32PipelineModel();
+
+    void reset();
+
+    uint32_t issue( addr_t pc, uint32_t ins, bool taken, uint64_t now );
+
+    /**
+     * Cycles from issue of an operation of class `op' to the issue
+     * of an instruction using its result, and cycles before the next
+     * operation on the same unit may issue (ignored for classes not
+     * using a multi-cycle unit).
+     */
+    void setLatency( enum OpClass op, uint32_t latency, uint32_t repeat = 1 );
+
+    /**
+     * Reads a latency table, one "class latency [repeat]" entry per
+     * line, class being the lowercase OpClass name without the OP_
+     * prefix (e.g. "div 33 33", "fp_mul 4"). Empty lines and lines
+     * starting with '#' are ignored. Returns false on a malformed
+     * line, leaving the entries read so far.
+     */
+    bool loadLatencies( std::istream &i );
+
+    void setForwarding( bool ex_ex, bool mem_ex );
+
+    /**
+     * Extra cycles lost on taken branches and jumps, beyond the delay
+     * slot.
+     */
+    void setBranchPenalty( uint32_t cycles );
+
+    /**
+     * Branches compare their operands in ID, one cycle before EX.
+     */
+    void setBranchInId( bool in_id );
+
+    inline uint64_t stallCycles() const
+    {
+        return m_stall_cycles;
+    }
+
+    static const char *className( enum OpClass op );
+
+private:
+    enum {
+        // Scoreboard entries: general registers, FPU register pairs,
+        // hi, lo, FPU condition codes. Entry 0 ($zero) is never
+        // written.
+        REG_FPR = 32,
+        REG_HI = REG_FPR + 16,
+        REG_LO,
+        REG_FCC,
+        REG_COUNT,
+
+        MAX_SRCS = 4,
+        MAX_DSTS = 2,
+
+        DECODE_CACHE_SIZE = 1024,
+    };
+
+    enum Unit {
+        UNIT_NONE,
+        UNIT_MDU,
+        UNIT_FPDIV,
+        UNIT_COUNT,
+    };
+
+    struct Decoded {
+        addr_t pc;
+        uint32_t ins;
+        uint8_t op;
+        uint8_t n_srcs;
+        uint8_t n_dsts;
+        // Source only needed at MEM, or MAX_SRCS
+        uint8_t late_src;
+        uint8_t srcs[MAX_SRCS];
+        uint8_t dsts[MAX_DSTS];
+    };
+
+    uint32_t m_latency[OP_CLASS_COUNT];
+    uint32_t m_repeat[OP_CLASS_COUNT];
+    bool m_ex_forwarding;
+    bool m_mem_forwarding;
+    uint32_t m_branch_penalty;
+    bool m_branch_in_id;
+
+    // Cycles registers are available and units are free at. Idle
+    // ones may be far in the past, hence 64-bit.
+    uint64_t m_ready[REG_COUNT];
+    uint64_t m_unit_free[UNIT_COUNT];
+    bool m_fresh;
+    uint64_t m_stall_cycles;
+
+    struct Decoded m_decode_cache[DECODE_CACHE_SIZE];
+
+    static void decode( struct Decoded &d, uint32_t ins );
+    static enum Unit unit( uint32_t op );
+
+    // Latency seen by consumers, given the forwarding paths
+    uint32_t available( uint32_t op ) const;
+};
+
+}}
+
+#endif // _SOCLIB_MIPS32_TIMING_H_
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -29,7 +29,6 @@
  */
 
 #include "mips32.h"
-#include "base_module.h"
 #include "soclib_endian.h"
 #include "arithmetics.h"
 #include <cstring>
@@ -37,28 +36,52 @@
 
 namespace soclib { namespace common {
 
-Mips32Iss::Mips32Iss(const std::string &name, uint32_t ident, bool default_little_endian)
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
+tmpl()::Mips32Iss(const std::string &name, uint32_t ident)
     : Iss2(name, ident),
-      m_little_endian(default_little_endian)
+      m_spin_detection(false),
+      m_spin_range_count(0),
+      m_block_execution(false),
+      m_jit_enabled(false),
+      m_functional(false),
+      m_icache_line_size(64),
+      m_jit_code(NULL),
+      m_dmi_count(0),
+      m_dmi_dreq(false),
+      m_profile(NULL),
+      m_trace(NULL),
+      m_timing(NULL),
+      m_cycles(0)
 {
     r_config.whole = 0;
     r_config.m = 1;
-    r_config.be = m_little_endian ? 0 : 1;
+    r_config.be = little_endian ? 0 : 1;
     r_config.ar = 1;
     r_config.mt = 7; // Reserved, let's say it's soclib generic MMU :)
 
     r_config1.whole = 0;
     r_config1.m = 1;
     r_config1.c2 = 1; // Advertize for Cop2 presence, i.e. generic MMU access
+    r_config1.pc = 1; // Performance counters
+    r_config1.fp = 1; // Floating point unit, see mips32_cop1.cpp
 
     r_config2.whole = 0;
     r_config2.m = 1;
 
     r_config3.whole = 0;
     r_config3.ulri = 1; // Advertize for TLS register
+    r_config3.vint = 1;
+
+    jitFlush();
 }
 
-void Mips32Iss::reset()
+tmpl()::~Mips32Iss()
+{
+    jitRelease();
+}
+
+tmpl(void)::reset()
 {
     struct DataRequest null_dreq = ISS_DREQ_INITIALIZER;
     r_ebase = 0x80000000 | m_ident;
@@ -68,14 +91,30 @@ void Mips32Iss::reset()
     m_ibe = false;
     m_dbe = false;
     m_dreq = null_dreq;
+    m_dmi_dreq = false;
     r_mem_dest = 0;
+    r_mem_pair = false;
     m_skip_next_instruction = false;
     m_ins_delay = 0;
+    m_mdu_delay = 0;
+    m_random = (m_ident + 1) * 0x9e3779b9 | 1;
     r_status.whole = 0x400004;
     r_cause.whole = 0;
+    r_intctl.whole = 0;
+    r_intctl.ipti = 7;
+    r_intctl.ippci = 7;
+    for ( size_t i = 0; i < PERF_COUNTERS; ++i ) {
+        r_perfctl[i].whole = 0;
+        r_perfcnt[i] = 0;
+    }
+    r_perfctl[0].m = 1;
+    m_perf_active = false;
     m_exec_cycles = 0;
     r_gp[0] = 0;
     m_sleeping = false;
+    m_spinning = false;
+    m_spin_cycles = 0;
+    spinForget();
     r_count = 0;
     r_compare = 0;
     r_tls_base = 0;
@@ -86,12 +125,22 @@ void Mips32Iss::reset()
     for(int i = 0; i<32; i++)
         r_gp[i] = 0;
 
+    for(int i = 0; i<32; i++)
+        r_fpr[i] = 0;
+    r_fcsr.whole = 0;
+    m_unusable_cop = 0;
+
     m_hazard=false;
     m_exception = NO_EXCEPTION;
     update_mode();
+
+    decodeCacheFlush();
+    m_decoded = &m_decode_cache[0];
+    if ( m_timing )
+        m_timing->reset();
 }
 
-void Mips32Iss::dump() const
+tmpl(void)::dump() const
 {
     std::cout
         << std::hex << std::showbase
@@ -128,7 +177,7 @@ void Mips32Iss::dump() const
     }
 }
 
-uint32_t Mips32Iss::executeNCycles(
+tmpl(uint32_t)::executeNCycles(
     uint32_t ncycle,
     const struct InstructionResponse &irsp,
     const struct DataResponse &drsp,
@@ -139,19 +188,35 @@ uint32_t Mips32Iss::executeNCycles(
 #endif
 
     bool may_take_irq = r_status.ie && !r_status.exl && !r_status.erl;
-    if ( m_little_endian )
-        m_ins.ins = irsp.instruction;
+
+    // Fetches from granted memory were not requested to the wrapper
+    const struct InstructionResponse *ir = &irsp;
+    struct InstructionResponse dmi_irsp = ISS_IRSP_INITIALIZER;
+    if ( ! m_sleeping && ! m_spinning && dmiFetch( r_pc, dmi_irsp.instruction ) ) {
+        dmi_irsp.valid = true;
+        ir = &dmi_irsp;
+    }
+
+    if ( little_endian )
+        m_ins.ins = ir->instruction;
     else
-        m_ins.ins = soclib::endian::uint32_swap(irsp.instruction);
-    m_ibe = irsp.error;
-    m_ireq_ok = irsp.valid;
+        m_ins.ins = soclib::endian::uint32_swap(ir->instruction);
+    m_ibe = ir->error;
+    m_ireq_ok = ir->valid;
+    if ( m_ireq_ok )
+        m_decoded = decode( r_pc, m_ins.ins );
 
-    _setData( drsp );
+    if ( m_dmi_dreq ) {
+        m_dmi_dreq = false;
+        _setData( m_dmi_drsp );
+    } else {
+        _setData( drsp );
+    }
 
     m_exception = NO_EXCEPTION;
 
     if ( m_sleeping ) {
-        if ( ((r_status.im>>2) & irq_bit_field)
+        if ( irqPending( irq_bit_field )
              && may_take_irq ) {
             m_exception = X_INT;
             m_sleeping = false;
@@ -159,7 +224,17 @@ uint32_t Mips32Iss::executeNCycles(
             std::cout << name() << " IRQ while sleeping" << std::endl;
 #endif
         } else {
-            r_count += ncycle;
+            addCount( ncycle );
+            return ncycle;
+        }
+    }
+    if ( m_spinning ) {
+        // Irq is taken after the loop head instruction
+        if ( irqPending( irq_bit_field ) && may_take_irq ) {
+            m_spinning = false;
+        } else {
+            m_spin_cycles += ncycle;
+            addCount( ncycle );
             return ncycle;
         }
     }
@@ -169,22 +244,91 @@ uint32_t Mips32Iss::executeNCycles(
             if ( m_ins_delay < ncycle )
                 t = m_ins_delay;
             m_ins_delay -= t;
+            perfCount( PERF_MDU_STALLS, t );
+            if ( m_profile )
+                m_profile->record( r_pc, Mips32Profile::INS_DELAY, t );
+        } else if ( ! m_dreq_ok ) {
+            perfCount( PERF_DFETCH_STALLS, t );
+            if ( m_profile )
+                m_profile->record( r_pc, Mips32Profile::DFETCH, t );
+        } else {
+            perfCount( PERF_IFETCH_STALLS, t );
+            if ( m_profile )
+                m_profile->record( r_pc, Mips32Profile::IFETCH, t );
         }
         m_hazard = false;
-        r_count += t;
+        addCount( t );
 #ifdef SOCLIB_MODULE_DEBUG
         std::cout << name() << " Frozen " << m_ireq_ok << m_dreq_ok<< " " << m_ins_delay << std::endl;
 #endif
         return t;
     }
 
+    uint32_t max_cycles = ncycle;
+
     if ( m_hazard && ncycle > 1 ) {
         ncycle = 2;
         m_hazard = false;
+        perfCount( PERF_HAZARD_STALLS );
+        if ( m_profile )
+            m_profile->record( r_pc, Mips32Profile::HAZARD, 1 );
     } else {
         ncycle = 1;
     }
-    r_count += ncycle;
+    addCount( ncycle );
+
+    executeInstruction( irq_bit_field );
+
+    if ( m_block_execution && ncycle < max_cycles )
+        ncycle += executeBlock( max_cycles - ncycle, irq_bit_field );
+    return ncycle;
+}
+
+tmpl(uint32_t)::executeQuantum(
+    uint32_t quantum,
+    LtMemory &mem,
+    uint32_t irq_bit_field )
+{
+    // Fetch timing is not relevant here, let executeNCycles() go on
+    // from the predecoded instructions between memory accesses.
+    bool block_execution = m_block_execution;
+    m_block_execution = true;
+    uint32_t n = Iss2::executeQuantum( quantum, mem, irq_bit_field );
+    m_block_execution = block_execution;
+    return n;
+}
+
+tmpl(uint32_t)::nextEventDelay( uint32_t irq_bit_field ) const
+{
+    bool may_take_irq = r_status.ie && !r_status.exl && !r_status.erl;
+    uint32_t delay;
+
+    if ( m_sleeping || m_spinning ) {
+        if ( irqPending( irq_bit_field ) && may_take_irq )
+            return 0;
+        delay = NO_EVENT;
+    } else if ( m_ins_delay ) {
+        delay = m_ins_delay;
+    } else {
+        return 0;
+    }
+
+    // Count reaching Compare, raising the timer interrupt
+    uint32_t compare = r_compare - r_count;
+    if ( compare && compare < delay )
+        delay = compare;
+    // Performance counter overflow interrupt
+    if ( m_perf_active ) {
+        uint32_t perf = perfOverflowDelay();
+        if ( perf < delay )
+            delay = perf;
+    }
+    return delay;
+}
+
+tmpl(void)::executeInstruction( uint32_t irq_bit_field )
+{
+    bool may_take_irq = r_status.ie && !r_status.exl && !r_status.erl;
 
     // The current instruction is executed in case of interrupt, but
     // the next instruction will be delayed.
@@ -228,14 +372,44 @@ uint32_t Mips32Iss::executeNCycles(
         std::cout << name() << " hazard, seeing next cycle" << std::endl;
 #endif
         m_hazard = false;
+        perfCount( PERF_HAZARD_STALLS );
+        if ( m_profile )
+            m_profile->record( r_pc, Mips32Profile::HAZARD, 1 );
+        goto house_keeping;
+    } else if ( m_spin_detection && spinCheck() ) {
+#ifdef SOCLIB_MODULE_DEBUG
+        std::cout << name() << " spinning @" << r_pc << std::endl;
+#endif
         goto house_keeping;
     } else {
+        // Mode the instruction is fetched and runs in
+        enum ExecMode mode = r_bus_mode;
         m_exec_cycles++;
+        if ( m_profile )
+            m_profile->record( r_pc, Mips32Profile::EXECUTED, 1 );
         run();
+        if ( m_trace && m_exception == NO_EXCEPTION ) {
+            if ( m_dreq.valid )
+                m_trace->retireAccess( r_pc, m_ins.ins, mode, m_dreq );
+            else
+                m_trace->retire( r_pc, m_ins.ins, mode );
+        }
+        if ( m_exception == NO_EXCEPTION )
+            m_observer.onRetire( r_pc, m_ins.ins, mode );
+        // Instruction ran in the cycle just counted, its stall is
+        // charged right after it
+        if ( m_timing && ! m_functional && m_exception == NO_EXCEPTION )
+            m_ins_delay = m_timing->issue(
+                r_pc, m_ins.ins, m_next_pc != r_npc+4, m_cycles-1 );
+        if ( m_perf_active && m_exception == NO_EXCEPTION ) {
+            perfEvent( PERF_INSTRUCTIONS, 1 );
+            if ( m_next_pc != r_npc+4 )
+                perfEvent( PERF_BRANCHES_TAKEN, 1 );
+        }
     }
 
     if ( m_exception == NO_EXCEPTION
-         && ((r_status.im>>2) & irq_bit_field)
+         && irqPending( irq_bit_field )
          && may_take_irq ) {
         m_exception = X_INT;
 #ifdef SOCLIB_MODULE_DEBUG
@@ -256,6 +430,9 @@ uint32_t Mips32Iss::executeNCycles(
 #endif
     }
 
+    if ( m_spin_detection )
+        spinRetire();
+
     if (  m_exception == NO_EXCEPTION )
         goto no_except;
 
@@ -268,6 +445,9 @@ uint32_t Mips32Iss::executeNCycles(
         addr_t except_address = exceptBaseAddr();
         bool branch_taken = m_next_pc != r_npc+4;
 
+        // Needed for vector selection
+        r_cause.ip  = irqLines( irq_bit_field )<<2;
+
         if ( r_status.exl ) {
             except_address += 0x180;
         } else {
@@ -286,6 +466,10 @@ uint32_t Mips32Iss::executeNCycles(
                 } else {
                     if ( branch_taken )
                         epc = r_pc;
+                    else if ( m_skip_next_instruction )
+                        // Not taken branch likely, its delay slot
+                        // is annulled: resume after it
+                        epc = m_next_pc;
                     else
                         epc = r_npc;
                 }
@@ -293,9 +477,8 @@ uint32_t Mips32Iss::executeNCycles(
             }
             except_address += exceptOffsetAddr(m_exception);
         }
-        r_cause.ce = 0;
+        r_cause.ce = m_exception == X_CPU ? m_unusable_cop : 0;
         r_cause.xcode = m_exception;
-        r_cause.ip  = irq_bit_field<<2;
         r_status.exl = 1;
         update_mode();
 
@@ -314,6 +497,11 @@ uint32_t Mips32Iss::executeNCycles(
             << std::endl;
 #endif
 
+        if ( m_exception == X_INT )
+            m_observer.onIrqTaken( r_cause.ip >> 2, r_pc, except_address );
+        else
+            m_observer.onException( m_exception, r_pc, except_address );
+
         m_next_pc = except_address;
         m_skip_next_instruction = true;
     }
@@ -328,10 +516,88 @@ uint32_t Mips32Iss::executeNCycles(
     }
  house_keeping:
     r_gp[0] = 0;
-    return ncycle;
 }
 
-int Mips32Iss::debugCpuCauseToSignal( uint32_t cause ) const
+tmpl(uint32_t)::executeBlock( uint32_t ncycle, uint32_t irq_bit_field )
+{
+    uint32_t done = 0;
+
+    // Following instructions are not fetched through the wrapper,
+    // they can't carry an instruction bus error.
+    m_ibe = false;
+
+    while ( done < ncycle ) {
+        if ( m_ins_delay ) {
+            uint32_t t = ncycle - done;
+            if ( m_ins_delay < t )
+                t = m_ins_delay;
+            m_ins_delay -= t;
+            perfCount( PERF_MDU_STALLS, t );
+            if ( m_profile )
+                m_profile->record( r_pc, Mips32Profile::INS_DELAY, t );
+            addCount( t );
+            done += t;
+            continue;
+        }
+
+        // Stop on anything needing the wrapper: pending data access,
+        // asynchronous bus error or sleep.
+        if ( (m_dreq.valid && ! m_dmi_dreq) || m_dbe || m_sleeping || m_spinning )
+            break;
+
+        // Instructions in granted memory are always read again, other
+        // ones must be predecoded.
+        const struct DecodedIns *d;
+        data_t ins;
+        if ( dmiFetch( r_pc, ins ) ) {
+            if ( ! little_endian )
+                ins = soclib::endian::uint32_swap(ins);
+            d = decode( r_pc, ins );
+        } else {
+            d = &m_decode_cache[(r_pc>>2)%DECODE_CACHE_SIZE];
+            if ( d->pc != r_pc )
+                break;
+        }
+
+        m_ins.ins = d->ins;
+        m_decoded = d;
+
+        if ( m_dmi_dreq ) {
+            m_dmi_dreq = false;
+            _setData( m_dmi_drsp );
+            // Second half of a doubleword FPU access was issued
+            if ( m_dreq.valid )
+                continue;
+        }
+
+        // Translated code is only looked up at block heads, i.e.
+        // targets of control transfers, never in a delay slot.
+        bool head = m_jit_head;
+        m_jit_head = false;
+        if ( head && m_jit_enabled && Observer::s_allow_jit
+             && ! m_trace && ! m_timing && ! m_hazard && r_npc == r_pc+4 ) {
+            uint32_t n = jitExecute( ncycle - done, irq_bit_field );
+            if ( n ) {
+                done += n;
+                continue;
+            }
+        }
+
+#ifdef SOCLIB_MODULE_DEBUG
+        std::cout << name() << " block execution @" << std::hex << r_pc << std::endl;
+#endif
+        m_exception = NO_EXCEPTION;
+        addCount( 1 );
+        done++;
+        addr_t pc = r_pc;
+        executeInstruction( irq_bit_field );
+        if ( r_pc != pc+4 )
+            m_jit_head = true;
+    }
+    return done;
+}
+
+tmpl(int)::debugCpuCauseToSignal( uint32_t cause ) const
 {
     switch (cause) {
     case X_INT:
@@ -362,12 +628,12 @@ int Mips32Iss::debugCpuCauseToSignal( uint32_t cause ) const
 
 // CDB
 #ifdef CDB_COMPONENT_IF_H
-const char *  Mips32Iss::local_GetModel()
+tmpl(const char *)::local_GetModel()
 {
     return("MIPS32");
 }
 
-int Mips32Iss::local_PrintResource(modelResource *res,char **p)
+tmpl(int)::local_PrintResource(modelResource *res,char **p)
 {
 int i = 1;
 int n;
@@ -630,7 +896,7 @@ char *s, *e;
 }
 
 
-int Mips32Iss::local_TestResource(modelResource *res,char **p){
+tmpl(int)::local_TestResource(modelResource *res,char **p){
     int i = 1;
     int n;
     char *s, *e;
@@ -744,7 +1010,7 @@ int Mips32Iss::local_TestResource(modelResource *res,char **p){
             fprintf(stderr, "Mips R300 No such ressource\n"); // todo fprintf cerr
         return -1;
 }
-int Mips32Iss::local_Resource(char **args)
+tmpl(int)::local_Resource(char **args)
 {
     size_t  i = 1;
 
@@ -763,7 +1029,7 @@ int Mips32Iss::local_Resource(char **args)
 }
 #endif
 
-Iss2::debug_register_t Mips32Iss::debugGetRegisterValue(unsigned int reg) const
+tmpl(Iss2::debug_register_t)::debugGetRegisterValue(unsigned int reg) const
 {
     switch (reg)
         {
@@ -783,12 +1049,18 @@ Iss2::debug_register_t Mips32Iss::debugGetRegisterValue(unsigned int reg) const
             return r_cause.whole;
         case 37:
             return r_pc;
+        case 38 ... 69:
+            return r_fpr[reg-38];
+        case 70:
+            return r_fcsr.whole;
+        case 71:
+            return fpuFir();
         default:
             return 0;
         }
 }
 
-void Mips32Iss::debugSetRegisterValue(unsigned int reg, debug_register_t value)
+tmpl(void)::debugSetRegisterValue(unsigned int reg, debug_register_t value)
 {
     switch (reg)
         {
@@ -814,6 +1086,12 @@ void Mips32Iss::debugSetRegisterValue(unsigned int reg, debug_register_t value)
             r_pc = value;
             r_npc = value+4;
             break;
+        case 38 ... 69:
+            r_fpr[reg-38] = value;
+            break;
+        case 70:
+            r_fcsr.whole = value;
+            break;
         default:
             break;
         }
@@ -832,43 +1110,63 @@ static size_t line_size_to_l( size_t line_size )
 }
 }
 
-void Mips32Iss::setICacheInfo( size_t line_size, size_t assoc, size_t n_lines )
+tmpl(void)::setProfile( Mips32Profile *profile )
+{
+    m_profile = profile;
+}
+
+tmpl(void)::setTrace( Iss2TraceWriter *trace )
+{
+    m_trace = trace;
+}
+
+tmpl(void)::setTiming( Mips32TimingModel *timing )
+{
+    m_timing = timing;
+    m_ins_delay = 0;
+    m_mdu_delay = 0;
+    m_hazard = false;
+    if ( m_timing )
+        m_timing->reset();
+}
+
+tmpl(void)::setICacheInfo( size_t line_size, size_t assoc, size_t n_lines )
 {
+    if ( line_size )
+        m_icache_line_size = line_size;
     r_config1.ia = assoc-1;
     r_config1.is = lines_to_s(n_lines);
     r_config1.il = line_size_to_l(line_size);
 }
 
-void Mips32Iss::setDCacheInfo( size_t line_size, size_t assoc, size_t n_lines )
+tmpl(void)::setDCacheInfo( size_t line_size, size_t assoc, size_t n_lines )
 {
     r_config1.da = assoc-1;
     r_config1.ds = lines_to_s(n_lines);
     r_config1.dl = line_size_to_l(line_size);
 }
 
-Mips32Iss::addr_t Mips32Iss::exceptOffsetAddr( enum ExceptCause cause ) const
+tmpl(Iss2::addr_t)::exceptOffsetAddr( enum ExceptCause cause ) const
 {
-    if ( r_cause.iv ) {
-        if ( r_status.bev || !r_intctl.vs )
-            return 0x200;
-        else {
-            int vn;
-
-            if ( r_config3.veic )
-                vn = r_cause.ip>>2;
-            else {
-                // TODO
-                SOCLIB_WARNING("Handling exception offset address when iv and !bev is still to do !");
-                vn = 0;
-            }
-            return 0x200 + vn * (r_intctl.vs<<5);
-        }
-    } else {
+    if ( cause != X_INT || !r_cause.iv )
         return 0x180;
+
+    if ( r_status.bev || !r_intctl.vs )
+        return 0x200;
+
+    int vn;
+    if ( r_config3.veic ) {
+        // Requested interrupt priority level
+        vn = r_cause.ip>>2;
+    } else {
+        // Highest priority pending line, IP7 first
+        uint32_t pending = r_cause.ip & r_status.im;
+        vn = pending ? uint32_log2(pending) : 0;
     }
+    return 0x200 + vn * (r_intctl.vs<<5);
 }
 
-Mips32Iss::addr_t Mips32Iss::exceptBaseAddr() const
+tmpl(Iss2::addr_t)::exceptBaseAddr() const
 {
     if ( r_status.bev )
         return 0xbfc00200;
@@ -876,6 +1174,36 @@ Mips32Iss::addr_t Mips32Iss::exceptBaseAddr() const
         return r_ebase & 0xfffff000;
 }
 
+MIPS32_INSTANTIATE(, Mips32Iss(const std::string &name, uint32_t ident))
+MIPS32_INSTANTIATE(, ~Mips32Iss())
+MIPS32_INSTANTIATE(void, reset())
+MIPS32_INSTANTIATE(void, dump() const)
+MIPS32_INSTANTIATE(uint32_t, executeNCycles(
+                       uint32_t ncycle,
+                       const struct InstructionResponse &irsp,
+                       const struct DataResponse &drsp,
+                       uint32_t irq_bit_field ))
+MIPS32_INSTANTIATE(uint32_t, executeQuantum( uint32_t quantum, LtMemory &mem, uint32_t irq_bit_field ))
+MIPS32_INSTANTIATE(uint32_t, nextEventDelay( uint32_t irq_bit_field ) const)
+MIPS32_INSTANTIATE(void, executeInstruction( uint32_t irq_bit_field ))
+MIPS32_INSTANTIATE(uint32_t, executeBlock( uint32_t ncycle, uint32_t irq_bit_field ))
+MIPS32_INSTANTIATE(int, debugCpuCauseToSignal( uint32_t cause ) const)
+#ifdef CDB_COMPONENT_IF_H
+MIPS32_INSTANTIATE(const char *, local_GetModel())
+MIPS32_INSTANTIATE(int, local_PrintResource(modelResource *res,char **p))
+MIPS32_INSTANTIATE(int, local_TestResource(modelResource *res,char **p))
+MIPS32_INSTANTIATE(int, local_Resource(char **args))
+#endif
+MIPS32_INSTANTIATE(Iss2::debug_register_t, debugGetRegisterValue(unsigned int reg) const)
+MIPS32_INSTANTIATE(void, debugSetRegisterValue(unsigned int reg, debug_register_t value))
+MIPS32_INSTANTIATE(void, setProfile( Mips32Profile *profile ))
+MIPS32_INSTANTIATE(void, setTrace( Iss2TraceWriter *trace ))
+MIPS32_INSTANTIATE(void, setTiming( Mips32TimingModel *timing ))
+MIPS32_INSTANTIATE(void, setICacheInfo( size_t line_size, size_t assoc, size_t n_lines ))
+MIPS32_INSTANTIATE(void, setDCacheInfo( size_t line_size, size_t assoc, size_t n_lines ))
+MIPS32_INSTANTIATE(Iss2::addr_t, exceptOffsetAddr( enum ExceptCause cause ) const)
+MIPS32_INSTANTIATE(Iss2::addr_t, exceptBaseAddr() const)
+
 }}
 
 // Local Variables:
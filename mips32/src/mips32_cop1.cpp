@@ -0,0 +1,739 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "mips32.h"
+#include "arithmetics.h"
+
+#include <cmath>
+#include <fenv.h>
+
+namespace soclib { namespace common {
+
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
+// MIPS32r2 floating point unit, single, double and word formats, with
+// Status.FR = 0. Arithmetic is done by the host FPU, under the
+// rounding mode of FCSR.RM, and host exception flags are turned into
+// FCSR cause bits.
+//
+// NaNs use the legacy MIPS encoding: a set mantissa MSB flags a
+// signaling NaN, operations returning a NaN return the default one.
+// FCSR.FS (flush to zero) is accepted but ignored, denormals are
+// always handled. The L and PS formats raise an unimplemented
+// operation exception.
+//
+// The host compiler must not fold or move floating point operations
+// around the fenv.h calls, build with -frounding-math to be safe.
+
+namespace {
+
+enum {
+    FP_ADD,
+    FP_SUB,
+    FP_MUL,
+    FP_DIV,
+    FP_SQRT,
+    FP_ABS,
+    FP_MOV,
+    FP_NEG,
+    FP_ROUND_L,
+    FP_TRUNC_L,
+    FP_CEIL_L,
+    FP_FLOOR_L,
+    FP_ROUND_W,
+    FP_TRUNC_W,
+    FP_CEIL_W,
+    FP_FLOOR_W,
+    FP_MOVCF = 0x11,
+    FP_MOVZ,
+    FP_MOVN,
+    FP_RECIP = 0x15,
+    FP_RSQRT,
+    FP_CVT_S = 0x20,
+    FP_CVT_D,
+    FP_CVT_W = 0x24,
+    FP_CVT_L,
+    FP_C = 0x30,
+};
+
+// Host rounding mode for each FCSR.RM value
+const int host_rounding[4] = {
+    FE_TONEAREST,
+    FE_TOWARDZERO,
+    FE_UPWARD,
+    FE_DOWNWARD,
+};
+
+struct FpSingle
+{
+    typedef float type;
+    typedef uint32_t bits;
+
+    // div, sqrt, recip and rsqrt
+    static const uint32_t latency = 12;
+
+    static inline bits defaultNan()
+    {
+        return 0x7fbfffff;
+    }
+
+    static inline bool isNan( bits v )
+    {
+        return (v & 0x7fffffff) > 0x7f800000;
+    }
+
+    static inline bool isSignaling( bits v )
+    {
+        return isNan(v) && (v & 0x00400000);
+    }
+
+    static inline type value( bits v )
+    {
+        union { bits b; type f; } u;
+        u.b = v;
+        return u.f;
+    }
+
+    static inline bits raw( type v )
+    {
+        union { bits b; type f; } u;
+        u.f = v;
+        return u.b;
+    }
+
+    static inline bits get( const uint32_t *fpr, uint32_t reg )
+    {
+        return fpr[reg];
+    }
+
+    static inline void set( uint32_t *fpr, uint32_t reg, bits v )
+    {
+        fpr[reg] = v;
+    }
+};
+
+struct FpDouble
+{
+    typedef double type;
+    typedef uint64_t bits;
+
+    static const uint32_t latency = 25;
+
+    static inline bits defaultNan()
+    {
+        return 0x7ff7ffffffffffffULL;
+    }
+
+    static inline bool isNan( bits v )
+    {
+        return (v & 0x7fffffffffffffffULL) > 0x7ff0000000000000ULL;
+    }
+
+    static inline bool isSignaling( bits v )
+    {
+        return isNan(v) && (v & 0x0008000000000000ULL);
+    }
+
+    static inline type value( bits v )
+    {
+        union { bits b; type f; } u;
+        u.b = v;
+        return u.f;
+    }
+
+    static inline bits raw( type v )
+    {
+        union { bits b; type f; } u;
+        u.f = v;
+        return u.b;
+    }
+
+    static inline bits get( const uint32_t *fpr, uint32_t reg )
+    {
+        reg &= ~1;
+        return ((uint64_t)fpr[reg+1] << 32) | fpr[reg];
+    }
+
+    static inline void set( uint32_t *fpr, uint32_t reg, bits v )
+    {
+        reg &= ~1;
+        fpr[reg] = v;
+        fpr[reg+1] = v >> 32;
+    }
+};
+
+// All operations below return their result bits and set `invalid'
+// on NaN operands raising the invalid operation exception. Host flags
+// are collected by fpuEnd(). Operands and results go through volatile variables so
+// that the operations really happen between fpuBegin() and fpuEnd().
+
+template<typename F>
+typename F::bits fpBinary( uint32_t op, typename F::bits a, typename F::bits b,
+                           bool &invalid )
+{
+    if ( F::isNan(a) || F::isNan(b) ) {
+        if ( F::isSignaling(a) || F::isSignaling(b) )
+            invalid = true;
+        return F::defaultNan();
+    }
+
+    volatile typename F::type x = F::value(a);
+    volatile typename F::type y = F::value(b);
+    volatile typename F::type r;
+    switch (op) {
+    case FP_ADD:
+        r = x + y;
+        break;
+    case FP_SUB:
+        r = x - y;
+        break;
+    case FP_MUL:
+        r = x * y;
+        break;
+    default:
+        r = x / y;
+        break;
+    }
+    // Invalid operations (inf - inf, 0 * inf, 0 / 0, ...)
+    typename F::bits rb = F::raw(r);
+    if ( F::isNan(rb) )
+        return F::defaultNan();
+    return rb;
+}
+
+template<typename F>
+typename F::bits fpUnary( uint32_t op, typename F::bits a, bool &invalid )
+{
+    if ( F::isNan(a) ) {
+        if ( F::isSignaling(a) )
+            invalid = true;
+        return F::defaultNan();
+    }
+
+    volatile typename F::type x = F::value(a);
+    volatile typename F::type r;
+    switch (op) {
+    case FP_ABS:
+        return F::raw(std::fabs(x));
+    case FP_NEG:
+        return F::raw(-x);
+    case FP_SQRT:
+        r = std::sqrt(x);
+        break;
+    case FP_RECIP:
+        r = 1 / x;
+        break;
+    default:
+        r = 1 / std::sqrt(x);
+        break;
+    }
+    typename F::bits rb = F::raw(r);
+    if ( F::isNan(rb) )
+        return F::defaultNan();
+    return rb;
+}
+
+template<typename From, typename To>
+typename To::bits fpConvert( typename From::bits a, bool &invalid )
+{
+    if ( From::isNan(a) ) {
+        if ( From::isSignaling(a) )
+            invalid = true;
+        return To::defaultNan();
+    }
+    volatile typename To::type r = From::value(a);
+    return To::raw(r);
+}
+
+// Out of range and NaN operands give the default result 2^31-1,
+// signaling invalid only.
+template<typename F>
+uint32_t fpToWord( typename F::bits a, bool &invalid )
+{
+    if ( ! F::isNan(a) ) {
+        volatile double x = F::value(a);
+        volatile double r = rint(x);
+        if ( r >= -2147483648.0 && r <= 2147483647.0 )
+            return (int32_t)r;
+    }
+    feclearexcept(FE_INEXACT);
+    invalid = true;
+    return 0x7fffffff;
+}
+
+template<typename F>
+typename F::bits fpFromWord( uint32_t w )
+{
+    volatile typename F::type r = (int32_t)w;
+    return F::raw(r);
+}
+
+// Condition is the 4-bit c.cond.fmt field: bit 0 unordered, bit 1
+// equal, bit 2 less than, bit 3 signals invalid on unordered.
+template<typename F>
+bool fpCompare( uint32_t cond, typename F::bits a, typename F::bits b,
+                bool &invalid )
+{
+    if ( F::isNan(a) || F::isNan(b) ) {
+        if ( (cond & 8) || F::isSignaling(a) || F::isSignaling(b) )
+            invalid = true;
+        return cond & 1;
+    }
+    typename F::type x = F::value(a);
+    typename F::type y = F::value(b);
+    return ((cond & 4) && x < y) || ((cond & 2) && x == y);
+}
+
+}
+
+tmpl(bool)::fpuUsable()
+{
+    // Contrary to Cop0, kernel mode has no implicit access, so that
+    // systems may switch FPU contexts lazily.
+    if ( r_status.cu1 )
+        return true;
+    m_unusable_cop = 1;
+    m_exception = X_CPU;
+    return false;
+}
+
+tmpl(void)::fpuBegin( int host_rounding )
+{
+    if ( host_rounding != FE_TONEAREST )
+        fesetround(host_rounding);
+    feclearexcept(FE_ALL_EXCEPT);
+}
+
+// Merges host flags in `cause', and updates FCSR. Returns whether
+// the result may be written, i.e. no exception is raised.
+tmpl(bool)::fpuEnd( uint32_t cause )
+{
+    int host = fetestexcept(FE_ALL_EXCEPT);
+    if ( fegetround() != FE_TONEAREST )
+        fesetround(FE_TONEAREST);
+
+    if ( host & FE_INVALID )
+        cause |= FP_V;
+    if ( host & FE_DIVBYZERO )
+        cause |= FP_Z;
+    if ( host & FE_OVERFLOW )
+        cause |= FP_O;
+    if ( host & FE_UNDERFLOW )
+        cause |= FP_U;
+    if ( host & FE_INEXACT )
+        cause |= FP_I;
+
+    return fpuRaise(cause);
+}
+
+// Updates FCSR with `cause' only, for operations computed without the
+// host FPU. Returns whether the result may be written.
+tmpl(bool)::fpuRaise( uint32_t cause )
+{
+    r_fcsr.cause = cause;
+    if ( cause & (r_fcsr.enables | FP_E) ) {
+        m_exception = X_FPE;
+        return false;
+    }
+    r_fcsr.flags |= cause;
+    return true;
+}
+
+tmpl(void)::fpuUnimplemented()
+{
+    r_fcsr.cause = FP_E;
+    m_exception = X_FPE;
+}
+
+tmpl(void)::fpuBranch()
+{
+    uint32_t cc = m_ins.i.rt >> 2;
+    bool likely = m_ins.i.rt & 0x2;
+    bool taken = fpuCondition(cc) == (bool)(m_ins.i.rt & 1);
+
+    if ( taken ) {
+        m_next_pc = sign_ext16(m_ins.i.imd)*4 + r_pc + 4;
+    } else if ( likely ) {
+        m_skip_next_instruction = true;
+    }
+}
+
+tmpl(template <typename F> void)::fpuArith()
+{
+    typedef typename F::bits bits;
+
+    uint32_t fd = m_ins.f.fd;
+    uint32_t fs = m_ins.f.fs;
+    uint32_t ft = m_ins.f.ft;
+    uint32_t func = m_ins.f.func;
+    bits a = F::get(r_fpr, fs);
+    bits b = F::get(r_fpr, ft);
+    bool invalid = false;
+
+    if ( func >= FP_C ) {
+        // Decided without host arithmetic, host flags are stale
+        bool cond = fpCompare<F>(func & 0xf, a, b, invalid);
+        if ( fpuRaise(invalid ? FP_V : 0) )
+            fpuSetCondition(fd >> 2, cond);
+        return;
+    }
+
+    // Non-arithmetic moves, no exception
+    switch (func) {
+    case FP_MOV:
+        F::set(r_fpr, fd, a);
+        return;
+    case FP_MOVCF:
+        if ( fpuCondition(ft >> 2) == (bool)(ft & 1) )
+            F::set(r_fpr, fd, a);
+        return;
+    case FP_MOVZ:
+        if ( r_gp[ft] == 0 )
+            F::set(r_fpr, fd, a);
+        return;
+    case FP_MOVN:
+        if ( r_gp[ft] != 0 )
+            F::set(r_fpr, fd, a);
+        return;
+    }
+
+    int rounding = host_rounding[r_fcsr.rm];
+    switch (func) {
+    case FP_ROUND_W:
+        rounding = FE_TONEAREST;
+        break;
+    case FP_TRUNC_W:
+        rounding = FE_TOWARDZERO;
+        break;
+    case FP_CEIL_W:
+        rounding = FE_UPWARD;
+        break;
+    case FP_FLOOR_W:
+        rounding = FE_DOWNWARD;
+        break;
+    }
+
+    fpuBegin(rounding);
+    switch (func) {
+    case FP_ADD:
+    case FP_SUB:
+    case FP_MUL:
+    case FP_DIV: {
+        bits r = fpBinary<F>(func, a, b, invalid);
+        if ( fpuEnd(invalid ? FP_V : 0) )
+            F::set(r_fpr, fd, r);
+        if ( func == FP_DIV )
+            setInsDelay( F::latency );
+        break;
+    }
+    case FP_SQRT:
+    case FP_RECIP:
+    case FP_RSQRT:
+        setInsDelay( F::latency );
+        // fall through
+    case FP_ABS:
+    case FP_NEG: {
+        bits r = fpUnary<F>(func, a, invalid);
+        if ( fpuEnd(invalid ? FP_V : 0) )
+            F::set(r_fpr, fd, r);
+        break;
+    }
+    case FP_ROUND_W:
+    case FP_TRUNC_W:
+    case FP_CEIL_W:
+    case FP_FLOOR_W:
+    case FP_CVT_W: {
+        uint32_t r = fpToWord<F>(a, invalid);
+        if ( fpuEnd(invalid ? FP_V : 0) )
+            r_fpr[fd] = r;
+        break;
+    }
+    case FP_CVT_S: {
+        if ( sizeof(bits) == sizeof(FpSingle::bits) ) {
+            fpuEnd(FP_E);
+            break;
+        }
+        FpSingle::bits r = fpConvert<F, FpSingle>(a, invalid);
+        if ( fpuEnd(invalid ? FP_V : 0) )
+            FpSingle::set(r_fpr, fd, r);
+        break;
+    }
+    case FP_CVT_D: {
+        if ( sizeof(bits) == sizeof(FpDouble::bits) ) {
+            fpuEnd(FP_E);
+            break;
+        }
+        FpDouble::bits r = fpConvert<F, FpDouble>(a, invalid);
+        if ( fpuEnd(invalid ? FP_V : 0) )
+            FpDouble::set(r_fpr, fd, r);
+        break;
+    }
+    default:
+        // 64-bit integer conversions, and reserved ones
+        fpuEnd(FP_E);
+        break;
+    }
+}
+
+tmpl(void)::fpuArithW()
+{
+    uint32_t w = r_fpr[m_ins.f.fs];
+
+    fpuBegin(host_rounding[r_fcsr.rm]);
+    switch (m_ins.f.func) {
+    case FP_CVT_S: {
+        FpSingle::bits r = fpFromWord<FpSingle>(w);
+        if ( fpuEnd(0) )
+            FpSingle::set(r_fpr, m_ins.f.fd, r);
+        break;
+    }
+    case FP_CVT_D: {
+        FpDouble::bits r = fpFromWord<FpDouble>(w);
+        if ( fpuEnd(0) )
+            FpDouble::set(r_fpr, m_ins.f.fd, r);
+        break;
+    }
+    default:
+        fpuEnd(FP_E);
+        break;
+    }
+}
+
+tmpl(void)::op_cop1()
+{
+    enum {
+        MF = 0,
+        CF = 2,
+        MFH = 3,
+        MT = 4,
+        CT = 6,
+        MTH = 7,
+        BC = 8,
+        FMT_S = 16,
+        FMT_D = 17,
+        FMT_W = 20,
+        FMT_L = 21,
+        FMT_PS = 22,
+    };
+
+    enum {
+        FIR = 0,
+        FCCR = 25,
+        FEXR = 26,
+        FENR = 28,
+        FCSR = 31,
+    };
+
+    if ( ! fpuUsable() )
+        return;
+
+    uint32_t rt = m_ins.f.ft;
+    uint32_t fs = m_ins.f.fs;
+
+    switch (m_ins.f.fmt) {
+    case MF:
+        r_gp[rt] = r_fpr[fs];
+        break;
+    case MFH:
+        r_gp[rt] = r_fpr[fs | 1];
+        break;
+    case MT:
+        r_fpr[fs] = r_gp[rt];
+        break;
+    case MTH:
+        r_fpr[fs | 1] = r_gp[rt];
+        break;
+    case CF:
+        switch (fs) {
+        case FIR:
+            r_gp[rt] = fpuFir();
+            break;
+        case FCCR:
+            r_gp[rt] = (r_fcsr.fcc << 1) | r_fcsr.fcc0;
+            break;
+        case FEXR:
+            r_gp[rt] = r_fcsr.whole & 0x0003f07c;
+            break;
+        case FENR:
+            r_gp[rt] = (r_fcsr.whole & 0xf80) | (r_fcsr.fs << 2) | r_fcsr.rm;
+            break;
+        case FCSR:
+            r_gp[rt] = r_fcsr.whole;
+            break;
+        default:
+            op_ill();
+        }
+        break;
+    case CT: {
+        uint32_t val = r_gp[rt];
+        switch (fs) {
+        case FCCR:
+            r_fcsr.fcc0 = val & 1;
+            r_fcsr.fcc = val >> 1;
+            break;
+        case FEXR:
+            r_fcsr.whole = (r_fcsr.whole & ~0x0003f07c) | (val & 0x0003f07c);
+            break;
+        case FENR:
+            r_fcsr.whole = (r_fcsr.whole & ~0xf80) | (val & 0xf80);
+            r_fcsr.fs = (val >> 2) & 1;
+            r_fcsr.rm = val & 3;
+            break;
+        case FCSR:
+            r_fcsr.whole = val & 0xfe83ffff;
+            break;
+        default:
+            op_ill();
+            return;
+        }
+        // Writing an enabled cause bit raises the exception right away
+        if ( r_fcsr.cause & (r_fcsr.enables | FP_E) )
+            m_exception = X_FPE;
+        break;
+    }
+    case BC:
+        fpuBranch();
+        break;
+    case FMT_S:
+        fpuArith<FpSingle>();
+        break;
+    case FMT_D:
+        fpuArith<FpDouble>();
+        break;
+    case FMT_W:
+        fpuArithW();
+        break;
+    case FMT_L:
+    case FMT_PS:
+        fpuUnimplemented();
+        break;
+    default:
+        op_ill();
+    }
+}
+
+tmpl(void)::op_cop1x()
+{
+    enum {
+        LWXC1 = 0x0,
+        LDXC1 = 0x1,
+        SWXC1 = 0x8,
+        SDXC1 = 0x9,
+        PREFX = 0xf,
+    };
+
+    enum {
+        MADD = 4,
+        MSUB = 5,
+        NMADD = 6,
+        NMSUB = 7,
+    };
+
+    if ( ! fpuUsable() )
+        return;
+
+    addr_t address = r_gp[m_ins.r.rs] + r_gp[m_ins.r.rt];
+
+    switch (m_ins.r.func) {
+    case LWXC1:
+        fpuLoadWord(address, m_ins.r.sh);
+        return;
+    case LDXC1:
+        fpuLoadDouble(address, m_ins.r.sh);
+        return;
+    case SWXC1:
+        fpuStoreWord(address, m_ins.r.rd);
+        return;
+    case SDXC1:
+        fpuStoreDouble(address, m_ins.r.rd);
+        return;
+    case PREFX:
+        return;
+    }
+
+    // Multiply-add, product is rounded before the addition
+    uint32_t op = m_ins.r.func >> 3;
+    uint32_t fmt = m_ins.r.func & 7;
+    if ( op < MADD || fmt > 1 ) {
+        if ( fmt == 6 )
+            fpuUnimplemented(); // PS
+        else
+            op_ill();
+        return;
+    }
+
+    uint32_t fr = m_ins.r.rs;
+    uint32_t ft = m_ins.r.rt;
+    uint32_t fs = m_ins.r.rd;
+    uint32_t fd = m_ins.r.sh;
+    uint32_t add = (op == MADD || op == NMADD) ? FP_ADD : FP_SUB;
+    bool negate = op == NMADD || op == NMSUB;
+    bool invalid = false;
+
+    fpuBegin(host_rounding[r_fcsr.rm]);
+    if ( fmt == 0 ) {
+        typedef FpSingle F;
+        F::bits p = fpBinary<F>(FP_MUL, F::get(r_fpr, fs), F::get(r_fpr, ft), invalid);
+        F::bits r = fpBinary<F>(add, p, F::get(r_fpr, fr), invalid);
+        if ( negate && ! F::isNan(r) )
+            r ^= 0x80000000;
+        if ( fpuEnd(invalid ? FP_V : 0) )
+            F::set(r_fpr, fd, r);
+    } else {
+        typedef FpDouble F;
+        F::bits p = fpBinary<F>(FP_MUL, F::get(r_fpr, fs), F::get(r_fpr, ft), invalid);
+        F::bits r = fpBinary<F>(add, p, F::get(r_fpr, fr), invalid);
+        if ( negate && ! F::isNan(r) )
+            r ^= 0x8000000000000000ULL;
+        if ( fpuEnd(invalid ? FP_V : 0) )
+            F::set(r_fpr, fd, r);
+    }
+}
+
+MIPS32_INSTANTIATE(bool, fpuUsable())
+MIPS32_INSTANTIATE(void, fpuBegin( int host_rounding ))
+MIPS32_INSTANTIATE(bool, fpuEnd( uint32_t cause ))
+MIPS32_INSTANTIATE(bool, fpuRaise( uint32_t cause ))
+MIPS32_INSTANTIATE(void, fpuUnimplemented())
+MIPS32_INSTANTIATE(void, fpuBranch())
+MIPS32_INSTANTIATE(void, fpuArithW())
+MIPS32_INSTANTIATE(void, op_cop1())
+MIPS32_INSTANTIATE(void, op_cop1x())
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
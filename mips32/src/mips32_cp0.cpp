@@ -29,13 +29,14 @@
  */
 
 #include "mips32.h"
-#include "base_module.h"
 #include "arithmetics.h"
 
 #include <strings.h>
 
 namespace soclib { namespace common {
 
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
 #define MIPS32_CPUID 0x00163200
 
 #define COPROC_REGNUM(no, sel) (((no)<<3)+sel)
@@ -49,6 +50,8 @@ enum Cp0Reg {
     COMPARE = COPROC_REGNUM(11,0),
     STATUS = COPROC_REGNUM(12,0),
     INTCTL = COPROC_REGNUM(12,1),
+    SRSCTL = COPROC_REGNUM(12,2),
+    SRSMAP = COPROC_REGNUM(12,3),
     CAUSE = COPROC_REGNUM(13,0),
     EPC = COPROC_REGNUM(14,0),
     CPUID = COPROC_REGNUM(15,0),
@@ -57,11 +60,17 @@ enum Cp0Reg {
     CONFIG_1 = COPROC_REGNUM(16,1),
     CONFIG_2 = COPROC_REGNUM(16,2),
     CONFIG_3 = COPROC_REGNUM(16,3),
+    PERFCTL_0 = COPROC_REGNUM(25,0),
+    PERFCNT_0 = COPROC_REGNUM(25,1),
+    PERFCTL_1 = COPROC_REGNUM(25,2),
+    PERFCNT_1 = COPROC_REGNUM(25,3),
     ERROR_EPC = COPROC_REGNUM(30,0),
 
     // Implementation dependant,
     // count of non-frozen cycles
     EXEC_CYCLES = COPROC_REGNUM(9,6),
+    // non-zero while in functional mode
+    FUNCTIONAL = COPROC_REGNUM(9,7),
 };
 
 static inline uint32_t merge(uint32_t oldval, uint32_t newval, uint32_t newmask)
@@ -69,7 +78,7 @@ static inline uint32_t merge(uint32_t oldval, uint32_t newval, uint32_t newmask)
     return (oldval & ~newmask) | (newval & newmask);
 }
 
-uint32_t Mips32Iss::cp0Get( uint32_t reg, uint32_t sel ) const
+tmpl(uint32_t)::cp0Get( uint32_t reg, uint32_t sel ) const
 {
     switch(COPROC_REGNUM(reg,sel)) {
     case INDEX:
@@ -88,6 +97,10 @@ uint32_t Mips32Iss::cp0Get( uint32_t reg, uint32_t sel ) const
         return r_status.whole;
     case INTCTL:
         return r_intctl.whole;
+    case SRSCTL:
+    case SRSMAP:
+        // No shadow register sets, every vector uses set 0
+        return 0;
     case CAUSE:
         return r_cause.whole;
     case EPC:
@@ -98,6 +111,8 @@ uint32_t Mips32Iss::cp0Get( uint32_t reg, uint32_t sel ) const
         return r_ebase;
     case EXEC_CYCLES:
         return m_exec_cycles;
+    case FUNCTIONAL:
+        return m_functional;
     case CONFIG:
         return r_config.whole;
     case CONFIG_1:
@@ -108,20 +123,29 @@ uint32_t Mips32Iss::cp0Get( uint32_t reg, uint32_t sel ) const
         return r_config3.whole;
     case ERROR_EPC:
         return r_error_epc;
+    case PERFCTL_0:
+    case PERFCTL_1:
+        return r_perfctl[sel/2].whole;
+    case PERFCNT_0:
+    case PERFCNT_1:
+        return r_perfcnt[sel/2];
     default:
         return 0;
     }
 }
 
 #define EBASE_WRITE_MASK 0x3ffff000
-#define INTCTL_WRITE_MASK 0xfc0
+#define INTCTL_WRITE_MASK 0x3e0
 #define CAUSE_WRITE_MASK 0x8c00300
+#define PERFCTL_WRITE_MASK 0x7ff
 
-void Mips32Iss::cp0Set( uint32_t reg, uint32_t sel, uint32_t val )
+tmpl(void)::cp0Set( uint32_t reg, uint32_t sel, uint32_t val )
 {
     switch(COPROC_REGNUM(reg, sel)) {
     case COMPARE:
+        // Acknowledges the timer interrupt
         r_compare = val;
+        r_cause.ti = 0;
         break;
     case COUNT:
         r_count = val;
@@ -134,13 +158,14 @@ void Mips32Iss::cp0Set( uint32_t reg, uint32_t sel, uint32_t val )
         break;
     case STATUS:
         r_status.whole = val;
+        r_status.fr = 0; // 32-bit FPU registers only
         update_mode();
         return;
     case EBASE:
         r_ebase = merge(r_ebase, val, EBASE_WRITE_MASK);
         break;
     case INTCTL:
-        r_intctl.whole = merge(r_intctl.whole, val, 0xfc0);
+        r_intctl.whole = merge(r_intctl.whole, val, INTCTL_WRITE_MASK);
         break;
     case EPC:
         r_epc = val;
@@ -151,12 +176,87 @@ void Mips32Iss::cp0Set( uint32_t reg, uint32_t sel, uint32_t val )
     case ERROR_EPC:
         r_error_epc = val;
         break;
+    case FUNCTIONAL:
+        setFunctional( val != 0 );
+        break;
+    case PERFCTL_0:
+    case PERFCTL_1:
+        r_perfctl[sel/2].whole = merge(r_perfctl[sel/2].whole, val, PERFCTL_WRITE_MASK);
+        perfUpdate();
+        break;
+    case PERFCNT_0:
+    case PERFCNT_1:
+        r_perfcnt[sel/2] = val;
+        perfUpdate();
+        break;
     default:
         return;
     }
 }
 
-bool Mips32Iss::isCopAccessible(int cp) const
+tmpl(void)::perfUpdate()
+{
+    m_perf_active = false;
+    r_cause.pci = 0;
+    for ( size_t i = 0; i < PERF_COUNTERS; ++i ) {
+        const perfctl_t &ctl = r_perfctl[i];
+        if ( ctl.u || ctl.s || ctl.k || ctl.exl )
+            m_perf_active = true;
+        // Overflow interrupt is requested while the counter MSB is set
+        if ( ctl.ie && (r_perfcnt[i] & 0x80000000) )
+            r_cause.pci = 1;
+    }
+}
+
+tmpl(void)::perfEvent( enum PerfEvent event, uint32_t n )
+{
+    bool overflow = false;
+    for ( size_t i = 0; i < PERF_COUNTERS; ++i ) {
+        const perfctl_t &ctl = r_perfctl[i];
+        if ( ctl.event != event || ! perfCounting( ctl ) )
+            continue;
+        r_perfcnt[i] += n;
+        if ( ctl.ie && (r_perfcnt[i] & 0x80000000) )
+            overflow = true;
+    }
+    if ( overflow )
+        r_cause.pci = 1;
+}
+
+// Whether the counter counts in the current mode
+tmpl(bool)::perfCounting( const perfctl_t &ctl ) const
+{
+    if ( r_status.exl || r_status.erl )
+        return ctl.exl;
+    if ( r_cpu_mode == MIPS32_USER )
+        return ctl.u;
+    if ( r_cpu_mode == MIPS32_SUPERVISOR )
+        return ctl.s;
+    return ctl.k;
+}
+
+// Cycles before a counter of the events going on while the core
+// waits (cycles, MDU stalls) sets its MSB, raising Cause.PCI. May be
+// early, never late.
+tmpl(uint32_t)::perfOverflowDelay() const
+{
+    uint32_t delay = NO_EVENT;
+    for ( size_t i = 0; i < PERF_COUNTERS; ++i ) {
+        const perfctl_t &ctl = r_perfctl[i];
+        if ( ! ctl.ie || ! perfCounting( ctl )
+             || (ctl.event != PERF_CYCLES && ctl.event != PERF_MDU_STALLS) )
+            continue;
+        // Already requested otherwise
+        if ( r_perfcnt[i] & 0x80000000 )
+            continue;
+        uint32_t left = 0x80000000 - r_perfcnt[i];
+        if ( left < delay )
+            delay = left;
+    }
+    return delay;
+}
+
+tmpl(bool)::isCopAccessible(int cp) const
 {
     if ( r_cpu_mode == MIPS32_KERNEL )
         return true;
@@ -174,32 +274,45 @@ bool Mips32Iss::isCopAccessible(int cp) const
     return false;
 }
 
-void Mips32Iss::update_mode()
+tmpl(void)::update_mode()
 {
+    enum ExecMode mode = r_bus_mode;
+
     if ( r_status.exl || r_status.erl ) {
-		r_bus_mode = MODE_KERNEL;
-		r_cpu_mode = MIPS32_KERNEL;
-        return;
+        r_bus_mode = MODE_KERNEL;
+        r_cpu_mode = MIPS32_KERNEL;
+    } else {
+        switch (r_status.ksu) {
+        case MIPS32_KSU_KERNEL:
+            r_bus_mode = MODE_KERNEL;
+            r_cpu_mode = MIPS32_KERNEL;
+            break;
+        case MIPS32_KSU_SUPERVISOR:
+            r_bus_mode = MODE_HYPER;
+            r_cpu_mode = MIPS32_SUPERVISOR;
+            break;
+        case MIPS32_KSU_USER:
+            r_bus_mode = MODE_USER;
+            r_cpu_mode = MIPS32_USER;
+            break;
+        default:
+            assert(0&&"Invalid user mode set in status register");
+        }
     }
-        
-	switch (r_status.ksu) {
-	case MIPS32_KSU_KERNEL:
-		r_bus_mode = MODE_KERNEL;
-		r_cpu_mode = MIPS32_KERNEL;
-		break;
-	case MIPS32_KSU_SUPERVISOR:
-		r_bus_mode = MODE_HYPER;
-		r_cpu_mode = MIPS32_SUPERVISOR;
-		break;
-	case MIPS32_KSU_USER:
-		r_bus_mode = MODE_USER;
-		r_cpu_mode = MIPS32_USER;
-		break;
-    default:
-		assert(0&&"Invalid user mode set in status register");
-	}
+
+    if ( r_bus_mode != mode )
+        m_observer.onModeChange( mode, r_bus_mode );
 }
 
+MIPS32_INSTANTIATE(uint32_t, cp0Get( uint32_t reg, uint32_t sel ) const)
+MIPS32_INSTANTIATE(void, cp0Set( uint32_t reg, uint32_t sel, uint32_t val ))
+MIPS32_INSTANTIATE(void, perfUpdate())
+MIPS32_INSTANTIATE(void, perfEvent( enum PerfEvent event, uint32_t n ))
+MIPS32_INSTANTIATE(bool, perfCounting( const perfctl_t &ctl ) const)
+MIPS32_INSTANTIATE(uint32_t, perfOverflowDelay() const)
+MIPS32_INSTANTIATE(bool, isCopAccessible(int cp) const)
+MIPS32_INSTANTIATE(void, update_mode())
+
 }}
 
 // Local Variables:
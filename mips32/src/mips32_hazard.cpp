@@ -29,25 +29,26 @@
  */
 
 #include "mips32.h"
-#include "base_module.h"
 #include "arithmetics.h"
 
 #include <strings.h>
 
 namespace soclib { namespace common {
 
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
 #define use(x) Mips32Iss::USE_##x
 #define use4(x, y, z, t) use(x), use(y), use(z), use(t)
 
-Mips32Iss::use_t const Mips32Iss::use_table[]= {
+tmpl(typename Mips32Iss<little_endian, Observer>::use_t const)::use_table[]= {
        use4(SPECIAL,    ST, NONE,  NONE),
        use4(     ST,    ST,    S,     S),
 
        use4(      S,     S,    S,     S),
        use4(      S,     S,    S,  NONE),
 
-       use4(     ST,  NONE, NONE,  NONE),
-       use4(   NONE,  NONE, NONE,  NONE),
+       use4(     ST,     T, NONE,    ST),
+       use4(     ST,    ST,    S,     S),
 
        use4(   NONE,  NONE, NONE,  NONE),
        use4(     ST,  NONE, NONE,  NONE),
@@ -58,15 +59,15 @@ Mips32Iss::use_t const Mips32Iss::use_table[]= {
        use4(     ST,    ST,   ST,    ST),
        use4(   NONE,  NONE,   ST,    ST),
 
-       use4(      S,  NONE, NONE,  NONE),
-       use4(   NONE,  NONE, NONE,  NONE),
+       use4(      S,     S, NONE,  NONE),
+       use4(   NONE,     S, NONE,  NONE),
 
-       use4(     ST,  NONE, NONE,  NONE),
-       use4(   NONE,  NONE, NONE,  NONE),
+       use4(     ST,     S, NONE,  NONE),
+       use4(   NONE,     S, NONE,  NONE),
 };
 
-Mips32Iss::use_t const Mips32Iss::use_special_table[] = {
-        use4(    T, NONE,    T,    T),
+tmpl(typename Mips32Iss<little_endian, Observer>::use_t const)::use_special_table[] = {
+        use4(    T,    S,    T,    T),
         use4(    T, NONE,    T,    T),
 
         use4(    S,    S, NONE, NONE),
@@ -91,13 +92,8 @@ Mips32Iss::use_t const Mips32Iss::use_special_table[] = {
         use4( NONE, NONE, NONE, NONE),
 };
 
-Mips32Iss::use_t Mips32Iss::curInstructionUsesRegs()
-{
-    use_t use = use_table[m_ins.i.op];
-    if ( use == USE_SPECIAL )
-        return use_special_table[m_ins.r.func];
-    return use;
-}
+MIPS32_INSTANTIATE_NESTED(use_t const, use_table[64])
+MIPS32_INSTANTIATE_NESTED(use_t const, use_special_table[64])
 
 }}
 
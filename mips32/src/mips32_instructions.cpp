@@ -29,15 +29,67 @@
  */
 
 #include "mips32.h"
-#include "base_module.h"
 #include "arithmetics.h"
 
 #include <strings.h>
 
 namespace soclib { namespace common {
 
-void Mips32Iss::op_bcond()
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
+tmpl(void)::op_bcond()
 {
+    enum {
+        TGEI = 0x8,
+        TGEIU = 0x9,
+        TLTI = 0xa,
+        TLTIU = 0xb,
+        TEQI = 0xc,
+        TNEI = 0xe,
+        SYNCI = 0x1f,
+    };
+
+    uint32_t rs = r_gp[m_ins.i.rs];
+    uint32_t imd = sign_ext16(m_ins.i.imd);
+
+    switch (m_ins.i.rt) {
+    case 0x0 ... 0x3:
+    case 0x10 ... 0x13:
+        break;
+    case TGEI:
+        if ( (int32_t)rs >= (int32_t)imd )
+            m_exception = X_TR;
+        return;
+    case TGEIU:
+        if ( rs >= imd )
+            m_exception = X_TR;
+        return;
+    case TLTI:
+        if ( (int32_t)rs < (int32_t)imd )
+            m_exception = X_TR;
+        return;
+    case TLTIU:
+        if ( rs < imd )
+            m_exception = X_TR;
+        return;
+    case TEQI:
+        if ( rs == imd )
+            m_exception = X_TR;
+        return;
+    case TNEI:
+        if ( rs != imd )
+            m_exception = X_TR;
+        return;
+    case SYNCI:
+        // Data side is write-through, only the instruction line needs
+        // an invalidation.
+        do_mem_access(4*XTN_ICACHE_INVAL, 4, false, 0, 0, (rs + imd)&~3, XTN_WRITE);
+        return;
+    default:
+        op_ill();
+        return;
+    }
+
     bool taken;
 
     taken = (int32_t)r_gp[m_ins.i.rs] < 0;
@@ -56,46 +108,46 @@ void Mips32Iss::op_bcond()
     }
 }
 
-void Mips32Iss::op_j()
+tmpl(void)::op_j()
 {
     m_next_pc = (r_pc&0xf0000000) | (m_ins.j.imd * 4);
 }
 
-void Mips32Iss::op_jal()
+tmpl(void)::op_jal()
 {
     r_gp[31] = r_pc+8;
     m_next_pc = (r_pc&0xf0000000) | (m_ins.j.imd * 4);
 }
 
-void Mips32Iss::op_beq()
+tmpl(void)::op_beq()
 {
     if ( r_gp[m_ins.i.rs] == r_gp[m_ins.i.rt] ) {
         m_next_pc = sign_ext16(m_ins.i.imd)*4 + r_pc + 4;
     }
 }
 
-void Mips32Iss::op_bne()
+tmpl(void)::op_bne()
 {
     if ( r_gp[m_ins.i.rs] != r_gp[m_ins.i.rt] ) {
         m_next_pc = sign_ext16(m_ins.i.imd)*4 + r_pc + 4;
     }
 }
 
-void Mips32Iss::op_blez()
+tmpl(void)::op_blez()
 {
     if ( (int32_t)r_gp[m_ins.i.rs] <= 0 ) {
         m_next_pc = sign_ext16(m_ins.i.imd)*4 + r_pc + 4;
     }
 }
 
-void Mips32Iss::op_bgtz()
+tmpl(void)::op_bgtz()
 {
     if ( (int32_t)r_gp[m_ins.i.rs] > 0 ) {
         m_next_pc = sign_ext16(m_ins.i.imd)*4 + r_pc + 4;
     }
 }
 
-void Mips32Iss::op_beql()
+tmpl(void)::op_beql()
 {
     if ( r_gp[m_ins.i.rs] == r_gp[m_ins.i.rt] ) {
         m_next_pc = sign_ext16(m_ins.i.imd)*4 + r_pc + 4;
@@ -104,7 +156,7 @@ void Mips32Iss::op_beql()
     }
 }
 
-void Mips32Iss::op_bnel()
+tmpl(void)::op_bnel()
 {
     if ( r_gp[m_ins.i.rs] != r_gp[m_ins.i.rt] ) {
         m_next_pc = sign_ext16(m_ins.i.imd)*4 + r_pc + 4;
@@ -113,7 +165,7 @@ void Mips32Iss::op_bnel()
     }
 }
 
-void Mips32Iss::op_blezl()
+tmpl(void)::op_blezl()
 {
     if ( (int32_t)r_gp[m_ins.i.rs] <= 0 ) {
         m_next_pc = sign_ext16(m_ins.i.imd)*4 + r_pc + 4;
@@ -122,7 +174,7 @@ void Mips32Iss::op_blezl()
     }
 }
 
-void Mips32Iss::op_bgtzl()
+tmpl(void)::op_bgtzl()
 {
     if ( (int32_t)r_gp[m_ins.i.rs] > 0 ) {
         m_next_pc = sign_ext16(m_ins.i.imd)*4 + r_pc + 4;
@@ -131,7 +183,7 @@ void Mips32Iss::op_bgtzl()
     }
 }
 
-void Mips32Iss::op_addi()
+tmpl(void)::op_addi()
 {
     uint64_t tmp = (uint64_t)r_gp[m_ins.i.rs] + (uint64_t)sign_ext16(m_ins.i.imd);
     if ( overflow( r_gp[m_ins.i.rs], sign_ext16(m_ins.i.imd), 0 ) )
@@ -140,46 +192,47 @@ void Mips32Iss::op_addi()
         r_gp[m_ins.i.rt] = tmp;
 }
 
-void Mips32Iss::op_addiu()
+tmpl(void)::op_addiu()
 {
     r_gp[m_ins.i.rt] = r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
 }
 
-void Mips32Iss::op_slti()
+tmpl(void)::op_slti()
 {
     r_gp[m_ins.i.rt] = (bool)
         ((int32_t)r_gp[m_ins.i.rs] < sign_ext16(m_ins.i.imd));
 }
 
-void Mips32Iss::op_sltiu()
+tmpl(void)::op_sltiu()
 {
     r_gp[m_ins.i.rt] = (bool)
         ((uint32_t)r_gp[m_ins.i.rs] < (uint32_t)sign_ext16(m_ins.i.imd));
 }
 
-void Mips32Iss::op_andi()
+tmpl(void)::op_andi()
 {
     r_gp[m_ins.i.rt] = r_gp[m_ins.i.rs] & m_ins.i.imd;
 }
 
-void Mips32Iss::op_ori()
+tmpl(void)::op_ori()
 {
     r_gp[m_ins.i.rt] = r_gp[m_ins.i.rs] | m_ins.i.imd;
 }
 
-void Mips32Iss::op_xori()
+tmpl(void)::op_xori()
 {
     r_gp[m_ins.i.rt] = r_gp[m_ins.i.rs] ^ m_ins.i.imd;
 }
 
-void Mips32Iss::op_lui()
+tmpl(void)::op_lui()
 {
     r_gp[m_ins.i.rt] = m_ins.i.imd << 16;
 }
 
-void Mips32Iss::op_cop0()
+tmpl(void)::op_cop0()
 {
     if (!isCopAccessible(0)) {
+        m_unusable_cop = 0;
         m_exception = X_CPU;
         return;
     }
@@ -187,7 +240,9 @@ void Mips32Iss::op_cop0()
     enum {
         MF = 0,
         MT = 4,
+        RDPGPR = 0xa,
         MFMC0 = 0xb,
+        WRPGPR = 0xe,
         CO1 = 0x10,
     };
 
@@ -242,13 +297,19 @@ void Mips32Iss::op_cop0()
             r_gp[m_ins.coproc.rt] = r_status.whole;
             r_status.ie = m_ins.coproc.sc;
             break;
+        case RDPGPR:
+        case WRPGPR:
+            // There is only one register set, previous one is the
+            // current one
+            r_gp[m_ins.coproc.rd] = r_gp[m_ins.coproc.rt];
+            break;
         default: // Not handled, so raise an exception
             op_ill();
         }
     }
 }
 
-void Mips32Iss::op_cop2()
+tmpl(void)::op_cop2()
 {
     enum {
         MF = 0,
@@ -256,6 +317,7 @@ void Mips32Iss::op_cop2()
     };
     
     if (!isCopAccessible(2)) {
+        m_unusable_cop = 2;
         m_exception = X_CPU;
         return;
     }
@@ -274,7 +336,12 @@ void Mips32Iss::op_cop2()
     }
 }
 
-void Mips32Iss::op_ill()
+tmpl(void)::op_pref()
+{
+    // Hint only
+}
+
+tmpl(void)::op_ill()
 {
     m_exception = X_RI;
 }
@@ -298,11 +365,14 @@ enum {
     FETCH_AND_LOCK,
 };
 
-void Mips32Iss::op_cache()
+tmpl(void)::op_cache()
 {
     uint32_t address =  (r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd))&~3;
 
     switch (m_ins.i.rt) {
+    case CACHE_OP(HIT_INVAL,ICACHE):
+        do_mem_access(4*XTN_ICACHE_INVAL, 4, false, 0, 0, address, XTN_WRITE);
+        break;
     case CACHE_OP(HIT_INVAL,DCACHE):
         do_mem_access(4*XTN_DCACHE_INVAL, 4, false, 0, 0, address, XTN_WRITE);
         break;
@@ -314,6 +384,31 @@ void Mips32Iss::op_cache()
     }
 }
 
+MIPS32_INSTANTIATE(void, op_bcond())
+MIPS32_INSTANTIATE(void, op_j())
+MIPS32_INSTANTIATE(void, op_jal())
+MIPS32_INSTANTIATE(void, op_beq())
+MIPS32_INSTANTIATE(void, op_bne())
+MIPS32_INSTANTIATE(void, op_blez())
+MIPS32_INSTANTIATE(void, op_bgtz())
+MIPS32_INSTANTIATE(void, op_beql())
+MIPS32_INSTANTIATE(void, op_bnel())
+MIPS32_INSTANTIATE(void, op_blezl())
+MIPS32_INSTANTIATE(void, op_bgtzl())
+MIPS32_INSTANTIATE(void, op_addi())
+MIPS32_INSTANTIATE(void, op_addiu())
+MIPS32_INSTANTIATE(void, op_slti())
+MIPS32_INSTANTIATE(void, op_sltiu())
+MIPS32_INSTANTIATE(void, op_andi())
+MIPS32_INSTANTIATE(void, op_ori())
+MIPS32_INSTANTIATE(void, op_xori())
+MIPS32_INSTANTIATE(void, op_lui())
+MIPS32_INSTANTIATE(void, op_cop0())
+MIPS32_INSTANTIATE(void, op_cop2())
+MIPS32_INSTANTIATE(void, op_pref())
+MIPS32_INSTANTIATE(void, op_ill())
+MIPS32_INSTANTIATE(void, op_cache())
+
 }}
 
 // Local Variables:
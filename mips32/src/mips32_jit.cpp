@@ -0,0 +1,563 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "mips32.h"
+#include "arithmetics.h"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#endif
+
+namespace soclib { namespace common {
+
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
+// Hot straight-line sequences of integer ALU instructions, found in
+// the predecoded instruction cache, are translated into host code
+// working directly on r_gp. Anything else (memory accesses, control
+// transfers, exceptions, hi/lo, cop0) stays in the interpreter, so a
+// translated block always runs to its end and only ever has to update
+// the PC and the cycle counters.
+
+namespace {
+
+enum {
+    OPCOD_SPECIAL = 0x00,
+    OPCOD_ADDIU = 0x09,
+    OPCOD_SLTI = 0x0a,
+    OPCOD_SLTIU = 0x0b,
+    OPCOD_ANDI = 0x0c,
+    OPCOD_ORI = 0x0d,
+    OPCOD_XORI = 0x0e,
+    OPCOD_LUI = 0x0f,
+};
+
+enum {
+    FUNC_SLL = 0x00,
+    FUNC_SRL = 0x02,
+    FUNC_SRA = 0x03,
+    FUNC_SLLV = 0x04,
+    FUNC_SRLV = 0x06,
+    FUNC_SRAV = 0x07,
+    FUNC_ADDU = 0x21,
+    FUNC_SUBU = 0x23,
+    FUNC_AND = 0x24,
+    FUNC_OR = 0x25,
+    FUNC_XOR = 0x26,
+    FUNC_NOR = 0x27,
+    FUNC_SLT = 0x2a,
+    FUNC_SLTU = 0x2b,
+};
+
+#if defined(__x86_64__)
+
+// Minimal x86-64 emitter. Generated functions take the address of
+// r_gp in %rdi and only clobber %eax and %ecx.
+class X86Emitter
+{
+    uint8_t *m_p;
+
+    enum {
+        EAX = 0,
+        ECX = 1,
+        RDI = 7,
+    };
+
+    inline void byte( uint8_t b )
+    {
+        *m_p++ = b;
+    }
+
+    inline void word( uint32_t w )
+    {
+        std::memcpy(m_p, &w, 4);
+        m_p += 4;
+    }
+
+    // <opcode> reg, [rdi+4*gpr]
+    inline void gp_operand( uint8_t opcode, int reg, uint32_t gpr )
+    {
+        byte(opcode);
+        byte(0x80 | (reg<<3) | RDI);
+        word(4*gpr);
+    }
+
+public:
+    enum Alu {
+        ADD = 0x03,
+        OR = 0x0b,
+        AND = 0x23,
+        SUB = 0x2b,
+        XOR = 0x33,
+        CMP = 0x3b,
+    };
+
+    enum Shift {
+        ROR = 1,
+        SHL = 4,
+        SHR = 5,
+        SAR = 7,
+    };
+
+    enum Cond {
+        BELOW = 0x92,
+        LESS = 0x9c,
+    };
+
+    X86Emitter( uint8_t *p )
+        : m_p(p)
+    {}
+
+    inline uint8_t *pos() const
+    {
+        return m_p;
+    }
+
+    void load( uint32_t gpr )
+    {
+        gp_operand(0x8b, EAX, gpr);
+    }
+
+    void load_count( uint32_t gpr )
+    {
+        gp_operand(0x8b, ECX, gpr);
+    }
+
+    void store( uint32_t gpr )
+    {
+        gp_operand(0x89, EAX, gpr);
+    }
+
+    void store_imm( uint32_t gpr, uint32_t imm )
+    {
+        gp_operand(0xc7, 0, gpr);
+        word(imm);
+    }
+
+    void alu( enum Alu op, uint32_t gpr )
+    {
+        gp_operand(op, EAX, gpr);
+    }
+
+    void alu_imm( enum Alu op, uint32_t imm )
+    {
+        // Accumulator short forms: op eax, imm32
+        byte(op+2);
+        word(imm);
+    }
+
+    void shift_imm( enum Shift op, uint8_t sh )
+    {
+        byte(0xc1);
+        byte(0xc0 | (op<<3) | EAX);
+        byte(sh);
+    }
+
+    void shift_count( enum Shift op )
+    {
+        byte(0xd3);
+        byte(0xc0 | (op<<3) | EAX);
+    }
+
+    void not_acc()
+    {
+        byte(0xf7);
+        byte(0xd0 | EAX);
+    }
+
+    void set_cond( enum Cond cond )
+    {
+        // setcc al; movzx eax, al
+        byte(0x0f);
+        byte(cond);
+        byte(0xc0);
+        byte(0x0f);
+        byte(0xb6);
+        byte(0xc0);
+    }
+
+    void ret()
+    {
+        byte(0xc3);
+    }
+};
+
+// Longest code for a single instruction, ret included
+static const size_t max_ins_code_size = 32;
+
+// Emits code for one instruction, returns false if it is not
+// translatable.
+static bool translate_ins( X86Emitter &e, uint32_t ins )
+{
+    uint32_t op = ins >> 26;
+    uint32_t rs = (ins >> 21) & 0x1f;
+    uint32_t rt = (ins >> 16) & 0x1f;
+    uint32_t rd = (ins >> 11) & 0x1f;
+    uint32_t sh = (ins >> 6) & 0x1f;
+    uint32_t func = ins & 0x3f;
+    uint32_t imd = ins & 0xffff;
+
+    switch (op) {
+    case OPCOD_SPECIAL:
+        // EHB hides in sll, and touches the mode
+        if ( ins == 0xc0 )
+            return false;
+        switch (func) {
+        case FUNC_SLL:
+        case FUNC_SRL:
+        case FUNC_SRA:
+        case FUNC_SLLV:
+        case FUNC_SRLV:
+        case FUNC_SRAV:
+        case FUNC_ADDU:
+        case FUNC_SUBU:
+        case FUNC_AND:
+        case FUNC_OR:
+        case FUNC_XOR:
+        case FUNC_NOR:
+        case FUNC_SLT:
+        case FUNC_SLTU:
+            break;
+        default:
+            return false;
+        }
+        // None of these can fault, writing r0 is a nop
+        if ( rd == 0 )
+            return true;
+        switch (func) {
+        case FUNC_SLL:
+            e.load(rt);
+            e.shift_imm(X86Emitter::SHL, sh);
+            break;
+        case FUNC_SRL:
+            e.load(rt);
+            e.shift_imm((rs & 1) ? X86Emitter::ROR : X86Emitter::SHR, sh);
+            break;
+        case FUNC_SRA:
+            e.load(rt);
+            e.shift_imm(X86Emitter::SAR, sh);
+            break;
+        case FUNC_SLLV:
+            e.load_count(rs);
+            e.load(rt);
+            e.shift_count(X86Emitter::SHL);
+            break;
+        case FUNC_SRLV:
+            e.load_count(rs);
+            e.load(rt);
+            e.shift_count((sh & 1) ? X86Emitter::ROR : X86Emitter::SHR);
+            break;
+        case FUNC_SRAV:
+            e.load_count(rs);
+            e.load(rt);
+            e.shift_count(X86Emitter::SAR);
+            break;
+        case FUNC_ADDU:
+            e.load(rs);
+            e.alu(X86Emitter::ADD, rt);
+            break;
+        case FUNC_SUBU:
+            e.load(rs);
+            e.alu(X86Emitter::SUB, rt);
+            break;
+        case FUNC_AND:
+            e.load(rs);
+            e.alu(X86Emitter::AND, rt);
+            break;
+        case FUNC_OR:
+            e.load(rs);
+            e.alu(X86Emitter::OR, rt);
+            break;
+        case FUNC_XOR:
+            e.load(rs);
+            e.alu(X86Emitter::XOR, rt);
+            break;
+        case FUNC_NOR:
+            e.load(rs);
+            e.alu(X86Emitter::OR, rt);
+            e.not_acc();
+            break;
+        case FUNC_SLT:
+            e.load(rs);
+            e.alu(X86Emitter::CMP, rt);
+            e.set_cond(X86Emitter::LESS);
+            break;
+        case FUNC_SLTU:
+            e.load(rs);
+            e.alu(X86Emitter::CMP, rt);
+            e.set_cond(X86Emitter::BELOW);
+            break;
+        }
+        e.store(rd);
+        return true;
+    case OPCOD_ADDIU:
+    case OPCOD_SLTI:
+    case OPCOD_SLTIU:
+    case OPCOD_ANDI:
+    case OPCOD_ORI:
+    case OPCOD_XORI:
+    case OPCOD_LUI:
+        break;
+    default:
+        return false;
+    }
+
+    if ( rt == 0 )
+        return true;
+    switch (op) {
+    case OPCOD_ADDIU:
+        e.load(rs);
+        e.alu_imm(X86Emitter::ADD, sign_ext16(imd));
+        break;
+    case OPCOD_SLTI:
+        e.load(rs);
+        e.alu_imm(X86Emitter::CMP, sign_ext16(imd));
+        e.set_cond(X86Emitter::LESS);
+        break;
+    case OPCOD_SLTIU:
+        e.load(rs);
+        e.alu_imm(X86Emitter::CMP, sign_ext16(imd));
+        e.set_cond(X86Emitter::BELOW);
+        break;
+    case OPCOD_ANDI:
+        e.load(rs);
+        e.alu_imm(X86Emitter::AND, imd);
+        break;
+    case OPCOD_ORI:
+        e.load(rs);
+        e.alu_imm(X86Emitter::OR, imd);
+        break;
+    case OPCOD_XORI:
+        e.load(rs);
+        e.alu_imm(X86Emitter::XOR, imd);
+        break;
+    case OPCOD_LUI:
+        e.store_imm(rt, imd << 16);
+        return true;
+    }
+    e.store(rt);
+    return true;
+}
+
+#endif
+
+}
+
+tmpl(void)::jitFlush()
+{
+    for ( size_t i = 0; i < JIT_CACHE_SETS; ++i ) {
+        for ( size_t w = 0; w < JIT_CACHE_WAYS; ++w ) {
+            m_jit_cache[i][w].pc = DECODE_INVALID_PC;
+            m_jit_cache[i][w].hits = 0;
+            m_jit_cache[i][w].n_ins = 0;
+            m_jit_cache[i][w].code = NULL;
+        }
+    }
+    m_jit_code_used = 0;
+    m_jit_head = false;
+    m_jit_lo = 0;
+    m_jit_hi = 0;
+}
+
+tmpl(void)::jitRelease()
+{
+#if defined(__x86_64__)
+    if ( m_jit_code )
+        munmap(m_jit_code, JIT_CODE_SIZE);
+#endif
+    m_jit_code = NULL;
+}
+
+tmpl(bool)::jitTranslate( struct JitBlock &b )
+{
+#if defined(__x86_64__)
+    if ( ! m_jit_code ) {
+        void *p = mmap(NULL, JIT_CODE_SIZE,
+                       PROT_READ|PROT_WRITE|PROT_EXEC,
+                       MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if ( p == MAP_FAILED ) {
+            // Host forbids executable memory, stay interpreted
+            m_jit_enabled = false;
+            return false;
+        }
+        m_jit_code = (uint8_t*)p;
+    }
+
+    if ( m_jit_code_used + (JIT_MAX_INS+1)*max_ins_code_size > JIT_CODE_SIZE ) {
+        addr_t pc = b.pc;
+        uint32_t hits = b.hits;
+        jitFlush();
+        b.pc = pc;
+        b.hits = hits;
+    }
+
+    uint8_t *start = m_jit_code + m_jit_code_used;
+    X86Emitter e(start);
+    uint32_t n = 0;
+    addr_t pc = b.pc;
+
+    while ( n < JIT_MAX_INS ) {
+        // Never span the user/kernel boundary, run() checks it
+        if ( (pc ^ b.pc) & 0x80000000 )
+            break;
+        const struct DecodedIns &d = m_decode_cache[(pc>>2)%DECODE_CACHE_SIZE];
+        if ( d.pc != pc || ! translate_ins(e, d.ins) )
+            break;
+        ++n;
+        pc += 4;
+    }
+    e.ret();
+
+    // A single instruction is not worth leaving the interpreter
+    if ( n < 2 )
+        return false;
+
+    b.n_ins = n;
+    b.code = (jit_func_t)start;
+    m_jit_code_used += e.pos() - start;
+    m_jit_code_used = (m_jit_code_used + 15) & ~(size_t)15;
+
+    if ( m_jit_lo == m_jit_hi ) {
+        m_jit_lo = b.pc;
+        m_jit_hi = pc;
+    } else {
+        if ( b.pc < m_jit_lo )
+            m_jit_lo = b.pc;
+        if ( pc > m_jit_hi )
+            m_jit_hi = pc;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+tmpl(typename Mips32Iss<little_endian, Observer>::JitBlock *)::jitLookup( addr_t pc )
+{
+    struct JitBlock *set = m_jit_cache[(pc>>2)%JIT_CACHE_SETS];
+    struct JitBlock *victim = NULL;
+
+    for ( size_t w = 0; w < JIT_CACHE_WAYS; ++w ) {
+        if ( set[w].pc == pc )
+            return &set[w];
+        // Untranslated entries are only counters, replace the coldest
+        if ( ! set[w].code && ( ! victim || set[w].hits < victim->hits ) )
+            victim = &set[w];
+    }
+
+    // A miss never evicts translated code at once: it ages the
+    // translated blocks of the set, and only takes the way of one
+    // that was not used since the previous misses.
+    if ( ! victim ) {
+        for ( size_t w = 0; w < JIT_CACHE_WAYS; ++w ) {
+            set[w].hits /= 2;
+            if ( ! set[w].hits && ! victim )
+                victim = &set[w];
+        }
+        if ( ! victim )
+            return NULL;
+    }
+
+    victim->pc = pc;
+    victim->hits = 0;
+    victim->n_ins = 0;
+    victim->code = NULL;
+    return victim;
+}
+
+tmpl(uint32_t)::jitExecute( uint32_t ncycle, uint32_t irq_bit_field )
+{
+    struct JitBlock *p = jitLookup( r_pc );
+    if ( ! p )
+        return 0;
+    struct JitBlock &b = *p;
+
+    if ( ! b.code ) {
+        if ( b.hits < JIT_THRESHOLD && ++b.hits == JIT_THRESHOLD )
+            jitTranslate(b);
+        // Block does not start with a translatable instruction, a
+        // translation may start at the next one.
+        if ( b.hits == JIT_THRESHOLD && ! b.code )
+            m_jit_head = true;
+        return 0;
+    }
+
+    // Let the interpreter handle anything that could interrupt the
+    // block: the translated code has no exit in the middle.
+    if ( b.n_ins > ncycle )
+        return 0;
+    if ( r_compare - r_count - 1 < b.n_ins )
+        return 0;
+    if ( isHighPC() && !isPriviliged() )
+        return 0;
+    if ( r_status.ie && !r_status.exl && !r_status.erl
+         && irqPending( irq_bit_field ) )
+        return 0;
+
+#ifdef SOCLIB_MODULE_DEBUG
+    std::cout << name() << " translated block @" << std::hex << r_pc
+              << " " << std::dec << b.n_ins << " instructions" << std::endl;
+#endif
+
+    b.code(r_gp);
+    r_gp[0] = 0;
+    if ( b.hits < JIT_THRESHOLD )
+        ++b.hits;
+
+    perfCount( PERF_INSTRUCTIONS, b.n_ins );
+    if ( m_profile )
+        for ( uint32_t i = 0; i < b.n_ins; ++i )
+            m_profile->record( r_pc + 4*i, Mips32Profile::EXECUTED, 1 );
+
+    addCount( b.n_ins );
+    m_exec_cycles += b.n_ins;
+    r_pc += 4*b.n_ins;
+    r_npc = r_pc+4;
+    return b.n_ins;
+}
+
+MIPS32_INSTANTIATE(void, jitFlush())
+MIPS32_INSTANTIATE(void, jitRelease())
+MIPS32_INSTANTIATE(bool, jitTranslate( struct JitBlock &b ))
+MIPS32_INSTANTIATE_NESTED(JitBlock *, jitLookup( addr_t pc ))
+MIPS32_INSTANTIATE(uint32_t, jitExecute( uint32_t ncycle, uint32_t irq_bit_field ))
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
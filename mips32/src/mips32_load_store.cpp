@@ -29,13 +29,14 @@
  */
 
 #include "mips32.h"
-#include "base_module.h"
 #include "arithmetics.h"
 
 #include <strings.h>
 
 namespace soclib { namespace common {
 
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
 namespace {
 template<typename data_t>
 data_t be_to_mask( data_t be )
@@ -54,13 +55,13 @@ data_t be_to_mask( data_t be )
 }
 }
 
-void Mips32Iss::do_mem_access( addr_t address,
-                               int byte_count,
-                               int sign_extend,
-                               int dest_reg,
-                               int dest_byte_in_reg,
-                               data_t wdata,
-                               enum DataOperationType operation )
+tmpl(void)::do_mem_access( addr_t address,
+                           int byte_count,
+                           int sign_extend,
+                           int dest_reg,
+                           int dest_byte_in_reg,
+                           data_t wdata,
+                           enum DataOperationType operation )
 {
     if (!isPriviliged() && isPrivDataAddr(address)) {
         m_dreq.addr = address;
@@ -71,7 +72,30 @@ void Mips32Iss::do_mem_access( addr_t address,
     int byte_le = address&3;
     assert( (byte_count + byte_le) <= 4 );
 
-    if ( ! m_little_endian ) {
+    // Keep the predecoded instructions coherent with our own writes
+    switch (operation) {
+    case DATA_READ:
+    case DATA_LL:
+        if ( ! r_mem_pair )
+            perfCount( PERF_LOADS );
+        break;
+    case DATA_WRITE:
+    case DATA_SC:
+        if ( ! r_mem_pair )
+            perfCount( PERF_STORES );
+        decodeCacheInval(address);
+        break;
+    case XTN_WRITE:
+        if ( address == 4*XTN_ICACHE_INVAL )
+            decodeCacheInvalLine(wdata);
+        else if ( address == 4*XTN_ICACHE_FLUSH )
+            decodeCacheFlush();
+        break;
+    default:
+        break;
+    }
+
+    if ( ! little_endian ) {
 //        byte_le = (4-byte_count)^byte_le;
         wdata = soclib::endian::uint32_swap(wdata) >> (8 * (4-byte_count));
     }
@@ -99,9 +123,66 @@ void Mips32Iss::do_mem_access( addr_t address,
     r_mem_offset_byte_in_reg = dest_byte_in_reg;
     r_mem_do_sign_extend = sign_extend;
     r_mem_dest = dest_reg;
+
+    m_observer.onMemRequest( m_dreq );
+
+    if ( operation == DATA_READ || operation == DATA_WRITE )
+        dmiAccess();
+}
+
+tmpl(void)::dmiAccess()
+{
+    bool write = m_dreq.type == DATA_WRITE;
+    uint8_t *p = dmiPtr( m_dreq.addr, write ? DMI_WRITE : DMI_READ );
+    if ( ! p )
+        return;
+
+    data_t rdata = 0;
+    if ( write ) {
+        for ( size_t i = 0; i < 4; ++i )
+            if ( m_dreq.be & (1<<i) )
+                p[i] = m_dreq.wdata >> (8*i);
+    } else {
+        rdata = dmiLoad( p );
+    }
+
+#ifdef SOCLIB_MODULE_DEBUG
+    std::cout << name() << " DMI access: " << m_dreq << " rdata: " << rdata << std::endl;
+#endif
+
+    m_dmi_drsp.valid = true;
+    m_dmi_drsp.error = false;
+    m_dmi_drsp.rdata = rdata;
+    m_dmi_dreq = true;
+}
+
+tmpl(bool)::dmiGrant( addr_t base, size_t size, uint8_t *host_ptr, int access )
+{
+    if ( m_dmi_count == DMI_MAX_REGIONS || size < 4 )
+        return false;
+
+    struct DmiRegion &r = m_dmi[m_dmi_count++];
+    r.base = base;
+    r.size = size;
+    r.host_ptr = host_ptr;
+    r.access = access;
+    return true;
 }
 
-void Mips32Iss::_setData(const struct DataResponse &rsp)
+tmpl(void)::dmiRevoke( addr_t base, size_t size )
+{
+    size_t i = 0;
+    while ( i < m_dmi_count ) {
+        const struct DmiRegion &r = m_dmi[i];
+        if ( (uint64_t)base < (uint64_t)r.base + r.size &&
+             (uint64_t)r.base < (uint64_t)base + size )
+            m_dmi[i] = m_dmi[--m_dmi_count];
+        else
+            ++i;
+    }
+}
+
+tmpl(void)::_setData(const struct DataResponse &rsp)
 {
     if ( ! m_dreq.valid ) {
         m_dreq_ok = true;
@@ -111,6 +192,10 @@ void Mips32Iss::_setData(const struct DataResponse &rsp)
     if ( !rsp.valid )
         return;
 
+    if ( m_trace && m_trace->pending() )
+        m_trace->complete( rsp );
+    m_observer.onMemResponse( m_dreq, rsp );
+
 #ifdef SOCLIB_MODULE_DEBUG
     std::cout
         << name()
@@ -123,8 +208,10 @@ void Mips32Iss::_setData(const struct DataResponse &rsp)
 
     m_dreq.valid = false;
     m_dbe = rsp.error;
-    if ( rsp.error )
+    if ( rsp.error ) {
+        r_mem_pair = false;
         return;
+    }
 
     // We write the  r_gp[i], and we detect a possible data dependency,
     // in order to implement the delayed load behaviour.
@@ -133,6 +220,8 @@ void Mips32Iss::_setData(const struct DataResponse &rsp)
     case DATA_LL:
     case DATA_SC:
     case XTN_READ: {
+        if ( ! builtinTiming() )
+            break;
         uint32_t reg_use = curInstructionUsesRegs();
         if ( (reg_use & USE_S && r_mem_dest == m_ins.r.rs) ||
              (reg_use & USE_T && r_mem_dest == m_ins.r.rt) )
@@ -146,15 +235,30 @@ void Mips32Iss::_setData(const struct DataResponse &rsp)
     }
 
     // With destination register == 0, this is a store or a load to r0.
-    if ( r_mem_dest == 0 )
-        return;
+    if ( r_mem_dest != 0 )
+        setDestData( rsp.rdata );
+
+    // Second word of a 64-bit FPU access, the core stays frozen until
+    // it completes. It belongs to the same instruction: not counted
+    // again, but traced.
+    if ( r_mem_pair ) {
+        do_mem_access(r_mem_pair_addr, 4, 0, r_mem_pair_dest, 0, r_mem_pair_wdata,
+                      r_mem_pair_dest ? DATA_READ : DATA_WRITE);
+        r_mem_pair = false;
+        if ( m_trace && m_dreq.valid )
+            m_trace->retirePair( m_dreq );
+        m_dreq_ok = false;
+    }
+}
 
-    data_t data = rsp.rdata;
+tmpl(void)::setDestData( data_t rdata )
+{
+    data_t data = rdata;
     int byte_count = r_mem_byte_count;
 
     data >>= 8*r_mem_byte_le;
 
-    if ( !m_little_endian ) {
+    if ( !little_endian ) {
         data_t sdata = soclib::endian::uint32_swap(data) >> (8 * (4-byte_count));
         data_t mask = be_to_mask<data_t>((1 << byte_count) - 1);
         data = sdata & mask;
@@ -164,7 +268,7 @@ void Mips32Iss::_setData(const struct DataResponse &rsp)
         << " BE swapping"
         << " count: " << byte_count
         << " le: " << r_mem_byte_le
-        << " orig data: " << rsp.rdata
+        << " orig data: " << rdata
         << " swapped data: " << sdata
         << " mask: " << mask
         << " data: " << data
@@ -198,21 +302,23 @@ void Mips32Iss::_setData(const struct DataResponse &rsp)
     data <<= 8*r_mem_offset_byte_in_reg;
     mask <<= 8*r_mem_offset_byte_in_reg;
 
-    data_t new_data = (data&mask) | (r_gp[r_mem_dest]&~mask);
+    data_t &dest = r_mem_dest < MEM_DEST_FPR
+        ? r_gp[r_mem_dest]
+        : r_fpr[r_mem_dest - MEM_DEST_FPR];
+    data_t new_data = (data&mask) | (dest&~mask);
 #ifdef SOCLIB_MODULE_DEBUG
     std::cout
         << name()
-        << " setData: " << rsp
+        << " setData: " << rdata
         << " off: " << r_mem_offset_byte_in_reg
         << " count: " << r_mem_byte_count
         << " le: " << r_mem_byte_le
-        << " old: " << r_gp[r_mem_dest]
-        << " from_mem: " << rsp.rdata
+        << " old: " << dest
         << " mask: " << mask
         << " new_data: " << new_data
         << std::endl;
 #endif
-    r_gp[r_mem_dest] = new_data;
+    dest = new_data;
 }
 
 #define check_align(address, align)      \
@@ -224,33 +330,33 @@ void Mips32Iss::_setData(const struct DataResponse &rsp)
 
 // Loads
 
-void Mips32Iss::op_lb()
+tmpl(void)::op_lb()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     do_mem_access(address, 1, 1, m_ins.i.rt, 0, 0, DATA_READ);
 }
 
-void Mips32Iss::op_lbu()
+tmpl(void)::op_lbu()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     do_mem_access(address, 1, -1, m_ins.i.rt, 0, 0, DATA_READ);
 }
 
-void Mips32Iss::op_lh()
+tmpl(void)::op_lh()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     check_align(address, 2);
     do_mem_access(address, 2, 2, m_ins.i.rt, 0, 0, DATA_READ);
 }
 
-void Mips32Iss::op_lhu()
+tmpl(void)::op_lhu()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     check_align(address, 2);
     do_mem_access(address, 2, -2, m_ins.i.rt, 0, 0, DATA_READ);
 }
 
-void Mips32Iss::op_lw()
+tmpl(void)::op_lw()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     check_align(address, 4);
@@ -259,14 +365,14 @@ void Mips32Iss::op_lw()
 
 // Stores
 
-void Mips32Iss::op_sb()
+tmpl(void)::op_sb()
 {
     uint32_t tmp = r_gp[m_ins.i.rt]&0xff;
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     do_mem_access(address, 1, 0, 0, 0, tmp, DATA_WRITE);
 }
 
-void Mips32Iss::op_sh()
+tmpl(void)::op_sh()
 {
     uint32_t tmp = r_gp[m_ins.i.rt]&0xffff;
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
@@ -274,7 +380,7 @@ void Mips32Iss::op_sh()
     do_mem_access(address, 2, 0, 0, 0, tmp, DATA_WRITE);
 }
 
-void Mips32Iss::op_sw()
+tmpl(void)::op_sw()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     check_align(address, 4);
@@ -283,75 +389,181 @@ void Mips32Iss::op_sw()
 
 // Unaligned accesses
 
-void Mips32Iss::op_lwl()
+tmpl(void)::op_lwl()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     uint32_t w = address&3;
-    int dest_byte = m_little_endian ?
+    int dest_byte = little_endian ?
         (3 - w):
         (w);
-    int byte_count = m_little_endian ?
+    int byte_count = little_endian ?
         (1 + w):
         (4 - w);
-    if ( m_little_endian )
+    if ( little_endian )
         address &= ~3;
     do_mem_access(address, byte_count, 0, m_ins.i.rt, dest_byte, 0, DATA_READ);
 }
 
-void Mips32Iss::op_swl()
+tmpl(void)::op_swl()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     uint32_t w = address&3;
-    int byte_count = m_little_endian ?
+    int byte_count = little_endian ?
         (1 + w):
         (4 - w);
-    if ( m_little_endian )
+    if ( little_endian )
         address &= ~3;
     data_t data = r_gp[m_ins.i.rt];
     data >>= 8*(4 - byte_count);
     do_mem_access(address, byte_count, 0, 0, 0, data, DATA_WRITE);
 }
 
-void Mips32Iss::op_lwr()
+tmpl(void)::op_lwr()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     uint32_t w = address&3;
-    int byte_count = m_little_endian ?
+    int byte_count = little_endian ?
         (4 - w):
         (1 + w);
-    if ( ! m_little_endian )
+    if ( ! little_endian )
         address &= ~3;
     do_mem_access(address, byte_count, 0, m_ins.i.rt, 0, 0, DATA_READ);
 }
 
-void Mips32Iss::op_swr()
+tmpl(void)::op_swr()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     uint32_t w = address&3;
-    int byte_count = m_little_endian ?
+    int byte_count = little_endian ?
         (4 - w):
         (1 + w);
-    if ( ! m_little_endian )
+    if ( ! little_endian )
         address &= ~3;
     do_mem_access(address, byte_count, 0, 0, 0, r_gp[m_ins.i.rt], DATA_WRITE);
 }
 
 // Atomic accesses
 
-void Mips32Iss::op_ll()
+tmpl(void)::op_ll()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     check_align(address, 4);
     do_mem_access(address, 4, 0, m_ins.i.rt, 0, 0, DATA_LL);
 }
 
-void Mips32Iss::op_sc()
+tmpl(void)::op_sc()
 {
     uint32_t address =  r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd);
     check_align(address, 4);
     do_mem_access(address, 4, 8, m_ins.i.rt, 0, r_gp[m_ins.i.rt], DATA_SC);
 }
 
+// Floating point accesses, the doubleword ones are split in two word
+// accesses, see _setData().
+
+tmpl(void)::fpuLoadWord( addr_t address, uint32_t ft )
+{
+    check_align(address, 4);
+    do_mem_access(address, 4, 0, MEM_DEST_FPR + ft, 0, 0, DATA_READ);
+}
+
+tmpl(void)::fpuLoadDouble( addr_t address, uint32_t ft )
+{
+    check_align(address, 8);
+    // Lowest address holds the low word on little endian only
+    uint32_t lo = MEM_DEST_FPR + (ft & ~1);
+    uint32_t hi = lo + 1;
+    do_mem_access(address, 4, 0, little_endian ? lo : hi, 0, 0, DATA_READ);
+    if ( m_exception != NO_EXCEPTION )
+        return;
+    r_mem_pair = true;
+    r_mem_pair_addr = address + 4;
+    r_mem_pair_dest = little_endian ? hi : lo;
+    r_mem_pair_wdata = 0;
+}
+
+tmpl(void)::fpuStoreWord( addr_t address, uint32_t ft )
+{
+    check_align(address, 4);
+    do_mem_access(address, 4, 0, 0, 0, r_fpr[ft], DATA_WRITE);
+}
+
+tmpl(void)::fpuStoreDouble( addr_t address, uint32_t ft )
+{
+    check_align(address, 8);
+    uint64_t v = fpuGetDouble(ft);
+    do_mem_access(address, 4, 0, 0, 0, little_endian ? v : v >> 32, DATA_WRITE);
+    if ( m_exception != NO_EXCEPTION )
+        return;
+    r_mem_pair = true;
+    r_mem_pair_addr = address + 4;
+    r_mem_pair_dest = 0;
+    r_mem_pair_wdata = little_endian ? v >> 32 : v;
+}
+
+tmpl(void)::op_lwc1()
+{
+    if ( ! fpuUsable() )
+        return;
+    fpuLoadWord(r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd), m_ins.i.rt);
+}
+
+tmpl(void)::op_ldc1()
+{
+    if ( ! fpuUsable() )
+        return;
+    fpuLoadDouble(r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd), m_ins.i.rt);
+}
+
+tmpl(void)::op_swc1()
+{
+    if ( ! fpuUsable() )
+        return;
+    fpuStoreWord(r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd), m_ins.i.rt);
+}
+
+tmpl(void)::op_sdc1()
+{
+    if ( ! fpuUsable() )
+        return;
+    fpuStoreDouble(r_gp[m_ins.i.rs] + sign_ext16(m_ins.i.imd), m_ins.i.rt);
+}
+
+MIPS32_INSTANTIATE(void, do_mem_access( addr_t address,
+                                         int byte_count,
+                                         int sign_extend,
+                                         int dest_reg,
+                                         int dest_byte_in_reg,
+                                         data_t wdata,
+                                         enum DataOperationType operation ))
+MIPS32_INSTANTIATE(void, dmiAccess())
+MIPS32_INSTANTIATE(bool, dmiGrant( addr_t base, size_t size, uint8_t *host_ptr, int access ))
+MIPS32_INSTANTIATE(void, dmiRevoke( addr_t base, size_t size ))
+MIPS32_INSTANTIATE(void, _setData(const struct DataResponse &rsp))
+MIPS32_INSTANTIATE(void, setDestData( data_t rdata ))
+MIPS32_INSTANTIATE(void, op_lb())
+MIPS32_INSTANTIATE(void, op_lbu())
+MIPS32_INSTANTIATE(void, op_lh())
+MIPS32_INSTANTIATE(void, op_lhu())
+MIPS32_INSTANTIATE(void, op_lw())
+MIPS32_INSTANTIATE(void, op_sb())
+MIPS32_INSTANTIATE(void, op_sh())
+MIPS32_INSTANTIATE(void, op_sw())
+MIPS32_INSTANTIATE(void, op_lwl())
+MIPS32_INSTANTIATE(void, op_swl())
+MIPS32_INSTANTIATE(void, op_lwr())
+MIPS32_INSTANTIATE(void, op_swr())
+MIPS32_INSTANTIATE(void, op_ll())
+MIPS32_INSTANTIATE(void, op_sc())
+MIPS32_INSTANTIATE(void, fpuLoadWord( addr_t address, uint32_t ft ))
+MIPS32_INSTANTIATE(void, fpuLoadDouble( addr_t address, uint32_t ft ))
+MIPS32_INSTANTIATE(void, fpuStoreWord( addr_t address, uint32_t ft ))
+MIPS32_INSTANTIATE(void, fpuStoreDouble( addr_t address, uint32_t ft ))
+MIPS32_INSTANTIATE(void, op_lwc1())
+MIPS32_INSTANTIATE(void, op_ldc1())
+MIPS32_INSTANTIATE(void, op_swc1())
+MIPS32_INSTANTIATE(void, op_sdc1())
+
 }}
 
 // Local Variables:
@@ -0,0 +1,190 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "mips32_profile.h"
+
+#include <cstring>
+#include <iomanip>
+
+namespace soclib { namespace common {
+
+namespace {
+
+// gmon.out layout, see gprof's gmon_out.h
+enum {
+    GMON_VERSION = 1,
+    GMON_TAG_TIME_HIST = 0,
+    GMON_HIST_MAX = 0xffff,
+    GMON_PROF_RATE = 1000000,
+};
+
+void put16( std::ostream &o, uint16_t v, bool big_endian )
+{
+    char b[2];
+    for ( size_t i = 0; i < 2; ++i )
+        b[big_endian ? 1-i : i] = v >> (8*i);
+    o.write(b, 2);
+}
+
+void put32( std::ostream &o, uint32_t v, bool big_endian )
+{
+    char b[4];
+    for ( size_t i = 0; i < 4; ++i )
+        b[big_endian ? 3-i : i] = v >> (8*i);
+    o.write(b, 4);
+}
+
+}
+
+Mips32Profile::Mips32Profile( uint32_t period )
+    : m_last_page(0),
+      m_last(NULL)
+{
+    setPeriod(period);
+}
+
+Mips32Profile::~Mips32Profile()
+{
+    clear();
+}
+
+void Mips32Profile::setPeriod( uint32_t period )
+{
+    m_period = period ? period : 1;
+    m_countdown = m_period;
+}
+
+struct Mips32Profile::Page *Mips32Profile::page( addr_t page_no )
+{
+    page_map_t::iterator i = m_pages.find(page_no);
+    if ( i != m_pages.end() )
+        return i->second;
+
+    struct Page *p = new struct Page;
+    std::memset(p, 0, sizeof(*p));
+    m_pages[page_no] = p;
+    return p;
+}
+
+void Mips32Profile::clear()
+{
+    for ( page_map_t::iterator i = m_pages.begin(); i != m_pages.end(); ++i )
+        delete i->second;
+    m_pages.clear();
+    m_last = NULL;
+    m_countdown = m_period;
+}
+
+void Mips32Profile::dumpText( std::ostream &o ) const
+{
+    o << "# pc executed ins_delay hazard ifetch dfetch" << std::endl;
+    for ( page_map_t::const_iterator i = m_pages.begin(); i != m_pages.end(); ++i ) {
+        const struct Page *p = i->second;
+        for ( size_t n = 0; n < PAGE_INS; ++n ) {
+            uint64_t total = 0;
+            for ( size_t e = 0; e < EVENT_COUNT; ++e )
+                total += p->count[e][n];
+            if ( ! total )
+                continue;
+            o << std::hex << std::setw(8) << std::setfill('0')
+              << ((i->first << PAGE_SHIFT) | (n << 2)) << std::dec;
+            for ( size_t e = 0; e < EVENT_COUNT; ++e )
+                o << ' ' << p->count[e][n];
+            o << std::endl;
+        }
+    }
+}
+
+void Mips32Profile::dumpGmon( std::ostream &o, bool big_endian ) const
+{
+    // One 4-byte bin per instruction, counts scaled to 16 bits
+    uint64_t max = 0;
+    for ( page_map_t::const_iterator i = m_pages.begin(); i != m_pages.end(); ++i )
+        for ( size_t n = 0; n < PAGE_INS; ++n ) {
+            uint64_t total = 0;
+            for ( size_t e = 0; e < EVENT_COUNT; ++e )
+                total += i->second->count[e][n];
+            if ( total > max )
+                max = total;
+        }
+    uint64_t scale = max / GMON_HIST_MAX + 1;
+    uint32_t rate = GMON_PROF_RATE / scale;
+    if ( ! rate )
+        rate = 1;
+
+    char header[20];
+    std::memset(header, 0, sizeof(header));
+    std::memcpy(header, "gmon", 4);
+    o.write(header, 4);
+    put32(o, GMON_VERSION, big_endian);
+    o.write(header+8, 12);
+
+    // One histogram record per run of contiguous pages
+    page_map_t::const_iterator i = m_pages.begin();
+    while ( i != m_pages.end() ) {
+        page_map_t::const_iterator end = i;
+        addr_t last = i->first;
+        for ( ++end; end != m_pages.end() && end->first == last+1; ++end )
+            last = end->first;
+
+        addr_t low = i->first << PAGE_SHIFT;
+        addr_t high = (last+1) << PAGE_SHIFT;
+        char dimen[15];
+        std::memset(dimen, 0, sizeof(dimen));
+        std::strcpy(dimen, "Mcycles");
+
+        o.put(GMON_TAG_TIME_HIST);
+        put32(o, low, big_endian);
+        put32(o, high, big_endian);
+        put32(o, (high-low) >> 2, big_endian);
+        put32(o, rate, big_endian);
+        o.write(dimen, sizeof(dimen));
+        o.put('M');
+
+        for ( ; i != end; ++i )
+            for ( size_t n = 0; n < PAGE_INS; ++n ) {
+                uint64_t total = 0;
+                for ( size_t e = 0; e < EVENT_COUNT; ++e )
+                    total += i->second->count[e][n];
+                put16(o, (total + scale/2) / scale, big_endian);
+            }
+    }
+}
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
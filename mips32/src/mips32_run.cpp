@@ -29,25 +29,26 @@
  */
 
 #include "mips32.h"
-#include "base_module.h"
 #include "arithmetics.h"
 
 #include <strings.h>
 
 namespace soclib { namespace common {
 
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
 #define op(x) &Mips32Iss::op_##x
 #define op4(x, y, z, t) op(x), op(y), op(z), op(t)
 
-Mips32Iss::func_t const Mips32Iss::opcod_table[]= {
+tmpl(typename Mips32Iss<little_endian, Observer>::func_t const)::opcod_table[]= {
     op4(special, bcond,    j,   jal),
     op4(    beq,   bne, blez,  bgtz),
 
     op4(   addi, addiu, slti, sltiu),
     op4(   andi,   ori, xori,   lui),
 
-    op4(   cop0,   ill, cop2,   ill),
-    op4(    ill,   ill,  ill,   ill),
+    op4(   cop0,  cop1, cop2, cop1x),
+    op4(   beql,  bnel,blezl, bgtzl),
 
     op4(    ill,   ill,  ill,   ill),
     op4(special2,  ill,  ill,special3),
@@ -58,24 +59,24 @@ Mips32Iss::func_t const Mips32Iss::opcod_table[]= {
     op4(     sb,    sh,  swl,    sw),
     op4(    ill,   ill,  swr, cache),
 
-    op4(     ll,   ill,  ill,   ill),
-    op4(    ill,   ill,  ill,   ill),
+    op4(     ll,  lwc1,  ill,  pref),
+    op4(    ill,  ldc1,  ill,   ill),
 
-    op4(     sc,   ill,  ill,   ill),
-    op4(    ill,   ill,  ill,   ill),
+    op4(     sc,  swc1,  ill,   ill),
+    op4(    ill,  sdc1,  ill,   ill),
 };
 
 #undef op
 #define op(x) #x
 
-const char *Mips32Iss::name_table[] = {
+tmpl(const char *)::name_table[] = {
     op4(special, bcond,    j,   jal),
     op4(    beq,   bne, blez,  bgtz),
 
     op4(   addi, addiu, slti, sltiu),
     op4(   andi,   ori, xori,   lui),
 
-    op4(   cop0,   ill, cop2,   ill),
+    op4(   cop0,  cop1, cop2, cop1x),
     op4(   beql,  bnel,blezl, bgtzl),
 
     op4(    ill,   ill,  ill,   ill),
@@ -87,18 +88,72 @@ const char *Mips32Iss::name_table[] = {
     op4(     sb,    sh,  swl,    sw),
     op4(    ill,   ill,  swr, cache),
 
-    op4(     ll,   ill,  ill,   ill),
-    op4(    ill,   ill,  ill,   ill),
+    op4(     ll,  lwc1,  ill,  pref),
+    op4(    ill,  ldc1,  ill,   ill),
 
-    op4(     sc,   ill,  ill,   ill),
-    op4(    ill,   ill,  ill,   ill),
+    op4(     sc,  swc1,  ill,   ill),
+    op4(    ill,  sdc1,  ill,   ill),
 };
 #undef op
 #undef op4
 
-void Mips32Iss::run()
+enum {
+    OPCOD_SPECIAL = 0x00,
+    OPCOD_SPECIAL2 = 0x1c,
+    OPCOD_SPECIAL3 = 0x1f,
+};
+
+// Resolves the handler down to the leaf function, so that a
+// predecoded instruction is always dispatched with a single indirect
+// call, whatever its opcode class.
+tmpl(void)::decodeIns( struct DecodedIns &d, addr_t pc, uint32_t ins ) const
 {
-    func_t func = opcod_table[m_ins.i.op];
+    ins_t i;
+    i.ins = ins;
+
+    d.pc = pc;
+    d.ins = ins;
+    switch ( i.i.op ) {
+    case OPCOD_SPECIAL:
+        d.func = special_table[i.r.func];
+        d.use = use_special_table[i.r.func];
+        break;
+    case OPCOD_SPECIAL2:
+        d.func = special2_table[i.r.func];
+        d.use = use_table[i.i.op];
+        break;
+    case OPCOD_SPECIAL3:
+        d.func = special3_table[i.r.func];
+        d.use = use_table[i.i.op];
+        break;
+    default:
+        d.func = opcod_table[i.i.op];
+        d.use = use_table[i.i.op];
+        break;
+    }
+}
+
+tmpl(void)::decodeCacheInvalLine( addr_t addr )
+{
+    addr_t base = addr & ~(addr_t)(m_icache_line_size-1);
+    for ( addr_t a = base; a < base+m_icache_line_size; a += 4 )
+        decodeCacheInval(a);
+}
+
+tmpl(void)::decodeCacheFlush()
+{
+    for ( size_t i = 0; i < DECODE_CACHE_SIZE; ++i ) {
+        m_decode_cache[i].pc = DECODE_INVALID_PC;
+        m_decode_cache[i].ins = 0;
+        m_decode_cache[i].func = &Mips32Iss::op_ill;
+        m_decode_cache[i].use = USE_NONE;
+    }
+    jitFlush();
+}
+
+tmpl(void)::run()
+{
+    func_t func = m_decoded->func;
 
     if (isHighPC() && !isPriviliged()) {
         m_exception = X_ADEL;
@@ -110,6 +165,13 @@ void Mips32Iss::run()
     (this->*func)();
 }
 
+MIPS32_INSTANTIATE_NESTED(func_t const, opcod_table[64])
+MIPS32_INSTANTIATE(const char *, name_table[64])
+MIPS32_INSTANTIATE(void, decodeIns( struct DecodedIns &d, addr_t pc, uint32_t ins ) const)
+MIPS32_INSTANTIATE(void, decodeCacheInvalLine( addr_t addr ))
+MIPS32_INSTANTIATE(void, decodeCacheFlush())
+MIPS32_INSTANTIATE(void, run())
+
 }}
 
 // Local Variables:
@@ -0,0 +1,175 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "mips32_sampler.h"
+
+#include <cassert>
+#include <cmath>
+
+namespace soclib { namespace common {
+
+#define tmpl(...) template<bool little_endian> __VA_ARGS__ Mips32Sampler<little_endian>
+
+tmpl()::Mips32Sampler( iss_t &iss,
+                       Iss2::LtMemory &mem,
+                       uint32_t period,
+                       uint32_t warmup,
+                       uint32_t window,
+                       uint32_t quantum )
+    : m_iss(iss),
+      m_mem(mem),
+      m_period(period),
+      m_warmup(warmup),
+      m_window(window),
+      m_quantum(quantum)
+{
+    assert( window > 0 && quantum > 0 && warmup + window <= period );
+    clear();
+    enterPhase( FAST_FORWARD );
+}
+
+tmpl(void)::clear()
+{
+    m_instructions = 0;
+    m_samples = 0;
+    m_mean = 0;
+    m_m2 = 0;
+}
+
+tmpl(void)::enterPhase( enum Phase phase )
+{
+    m_phase = phase;
+    switch ( phase ) {
+    case FAST_FORWARD:
+        m_left = m_period - m_warmup - m_window;
+        break;
+    case WARMUP:
+        m_left = m_warmup;
+        break;
+    case WINDOW:
+        m_left = m_window;
+        m_window_cycles = m_iss.cycleCount();
+        m_window_retired = m_iss.retiredCount();
+        break;
+    }
+    m_iss.setFunctional( phase == FAST_FORWARD );
+}
+
+tmpl(void)::addSample( double cpi )
+{
+    double delta = cpi - m_mean;
+    m_samples++;
+    m_mean += delta / m_samples;
+    m_m2 += delta * (cpi - m_mean);
+}
+
+tmpl(uint64_t)::run( uint64_t ninstructions, uint32_t irq_bit_field )
+{
+    uint64_t done = 0;
+
+    m_iss.setFunctional( m_phase == FAST_FORWARD );
+    while ( done < ninstructions ) {
+        if ( m_left == 0 ) {
+            switch ( m_phase ) {
+            case FAST_FORWARD:
+                enterPhase( WARMUP );
+                break;
+            case WARMUP:
+                enterPhase( WINDOW );
+                break;
+            case WINDOW:
+                addSample( (double)(m_iss.cycleCount() - m_window_cycles)
+                           / (m_iss.retiredCount() - m_window_retired) );
+                enterPhase( FAST_FORWARD );
+                break;
+            }
+            continue;
+        }
+
+        if ( m_iss.nextEventDelay( irq_bit_field ) == Iss2::NO_EVENT )
+            break;
+
+        // An instruction takes at least a cycle, a quantum no longer
+        // than the phase does not overshoot it.
+        uint32_t quantum = m_quantum < m_left ? m_quantum : m_left;
+        uint32_t before = m_iss.retiredCount();
+        if ( m_phase == FAST_FORWARD )
+            m_iss.executeQuantum( quantum, m_mem, irq_bit_field );
+        else
+            // Generic loop: no block execution, every fetch is timed
+            m_iss.Iss2::executeQuantum( quantum, m_mem, irq_bit_field );
+        uint32_t retired = m_iss.retiredCount() - before;
+
+        m_left -= retired < m_left ? retired : m_left;
+        done += retired;
+    }
+
+    m_instructions += done;
+    if ( m_phase == FAST_FORWARD )
+        m_iss.setFunctional( false );
+    return done;
+}
+
+tmpl(double)::cpiError( double z ) const
+{
+    if ( m_samples < 2 )
+        return 0;
+    double variance = m_m2 / (m_samples - 1);
+    return z * std::sqrt( variance / m_samples );
+}
+
+tmpl(void)::report( std::ostream &o, double z ) const
+{
+    double err = cpiError( z );
+    o << std::dec
+      << "instructions: " << m_instructions << std::endl
+      << "samples: " << m_samples
+      << " (" << m_window << " instructions, "
+      << m_warmup << " warm-up, every " << m_period << ")" << std::endl
+      << "CPI: " << m_mean << " +/- " << err
+      << " (z=" << z << ")" << std::endl;
+    if ( m_mean > 0 )
+        o << "relative error: " << 100 * err / m_mean << "%" << std::endl
+          << "estimated cycles: " << (uint64_t)(m_mean * m_instructions) << std::endl;
+}
+
+template class Mips32Sampler<true>;
+template class Mips32Sampler<false>;
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
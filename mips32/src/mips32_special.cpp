@@ -36,6 +36,8 @@
 
 namespace soclib { namespace common {
 
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
 namespace {
 // Avoid duplication of source code, this kind of op
 // is easy to bug, and should be easy to debug 
@@ -60,7 +62,7 @@ static inline uint32_t sra( uint32_t reg, uint32_t sh )
 }
 }
 
-void Mips32Iss::special_sll()
+tmpl(void)::special_sll()
 {
     // EHB is hidden here if sh == 3 and r[tsd] == 0, ie ins = 0xc0
     // That is ugly !
@@ -71,7 +73,7 @@ void Mips32Iss::special_sll()
     }
 }
 
-void Mips32Iss::special_srl()
+tmpl(void)::special_srl()
 {
     if ( m_ins.r.rs&1 )
         r_gp[m_ins.r.rd] = rotr(r_gp[m_ins.i.rt], m_ins.r.sh);
@@ -79,17 +81,17 @@ void Mips32Iss::special_srl()
         r_gp[m_ins.r.rd] = srl(r_gp[m_ins.i.rt], m_ins.r.sh);
 }
 
-void Mips32Iss::special_sra()
+tmpl(void)::special_sra()
 {
     r_gp[m_ins.r.rd] = sra(r_gp[m_ins.i.rt], m_ins.r.sh);
 }
 
-void Mips32Iss::special_sllv()
+tmpl(void)::special_sllv()
 {
     r_gp[m_ins.r.rd] = sll(r_gp[m_ins.i.rt], r_gp[m_ins.i.rs]&0x1f );
 }
 
-void Mips32Iss::special_srlv()
+tmpl(void)::special_srlv()
 {
     if ( m_ins.r.sh&1 )
         r_gp[m_ins.r.rd] = rotr(r_gp[m_ins.i.rt], r_gp[m_ins.i.rs]&0x1f);
@@ -97,12 +99,12 @@ void Mips32Iss::special_srlv()
         r_gp[m_ins.r.rd] = srl(r_gp[m_ins.i.rt], r_gp[m_ins.i.rs]&0x1f);
 }
 
-void Mips32Iss::special_srav()
+tmpl(void)::special_srav()
 {
     r_gp[m_ins.r.rd] = sra(r_gp[m_ins.i.rt], r_gp[m_ins.i.rs]&0x1f );
 }
 
-void Mips32Iss::special_jr()
+tmpl(void)::special_jr()
 {
     if (isPrivDataAddr(r_gp[m_ins.i.rs]) && !isPriviliged()) {
         // TODO error code
@@ -112,7 +114,7 @@ void Mips32Iss::special_jr()
     m_next_pc = r_gp[m_ins.i.rs];
 }
 
-void Mips32Iss::special_jalr()
+tmpl(void)::special_jalr()
 {
     if (isPrivDataAddr(r_gp[m_ins.i.rs]) && !isPriviliged()) {
         // TODO error code
@@ -123,97 +125,99 @@ void Mips32Iss::special_jalr()
     m_next_pc = r_gp[m_ins.i.rs];
 }
 
-void Mips32Iss::special_sysc()
+tmpl(void)::special_sysc()
 {
     m_exception = X_SYS;
 }
 
-void Mips32Iss::special_brek()
+tmpl(void)::special_brek()
 {
     m_exception = X_BP;
 }
 
-void Mips32Iss::special_mfhi()
+tmpl(void)::special_mfhi()
 {
+    mduWait();
     r_gp[m_ins.r.rd] = r_hi;
 }
 
-void Mips32Iss::special_movn()
+tmpl(void)::special_movn()
 {
     if ( r_gp[m_ins.i.rt] != 0 )
         r_gp[m_ins.r.rd] = r_gp[m_ins.i.rs];
 }
 
-void Mips32Iss::special_movz()
+tmpl(void)::special_movz()
 {
     if ( r_gp[m_ins.i.rt] == 0 )
         r_gp[m_ins.r.rd] = r_gp[m_ins.i.rs];
 }
 
-void Mips32Iss::special_mthi()
+tmpl(void)::special_mthi()
 {
+    mduWait();
     r_hi = r_gp[m_ins.i.rs];
 }
 
-void Mips32Iss::special_mflo()
+tmpl(void)::special_mflo()
 {
+    mduWait();
     r_gp[m_ins.r.rd] = r_lo;
 }
 
-void Mips32Iss::special_mtlo()
+tmpl(void)::special_mtlo()
 {
+    mduWait();
     r_lo = r_gp[m_ins.i.rs];
 }
 
-void Mips32Iss::special_mult()
+tmpl(void)::special_mult()
 {
     int64_t a = (int32_t)r_gp[m_ins.i.rs];
     int64_t b = (int32_t)r_gp[m_ins.i.rt];
     int64_t res = a*b;
     r_hi = res>>32;
     r_lo = res;
-    if (r_gp[m_ins.i.rt])
-        setInsDelay( 3 );
+    mduIssue( r_gp[m_ins.i.rt] ? 3 : 0 );
 }
 
-void Mips32Iss::special_multu()
+tmpl(void)::special_multu()
 {
     uint64_t a = r_gp[m_ins.i.rs];
     uint64_t b = r_gp[m_ins.i.rt];
     uint64_t res = a*b;
     r_hi = res>>32;
     r_lo = res;
-    if (r_gp[m_ins.i.rt])
-        setInsDelay( 3 );
+    mduIssue( r_gp[m_ins.i.rt] ? 3 : 0 );
 }
 
-void Mips32Iss::special_div()
+tmpl(void)::special_div()
 {
     if ( ! r_gp[m_ins.i.rt] ) {
-        r_hi = random();
-        r_lo = random();
+        mduIssue( 0 );
+        r_hi = unpredictable();
+        r_lo = unpredictable();
         return;
     }
     r_hi = (int32_t)r_gp[m_ins.i.rs] % (int32_t)r_gp[m_ins.i.rt];
     r_lo = (int32_t)r_gp[m_ins.i.rs] / (int32_t)r_gp[m_ins.i.rt];
-    if (r_gp[m_ins.i.rt])
-        setInsDelay( ::soclib::common::clz(r_gp[m_ins.i.rt])+1 );
+    mduIssue( ::soclib::common::clz(r_gp[m_ins.i.rt])+1 );
 }
 
-void Mips32Iss::special_divu()
+tmpl(void)::special_divu()
 {
     if ( ! r_gp[m_ins.i.rt] ) {
-        r_hi = random();
-        r_lo = random();
+        mduIssue( 0 );
+        r_hi = unpredictable();
+        r_lo = unpredictable();
         return;
     }
     r_hi = r_gp[m_ins.i.rs] % r_gp[m_ins.i.rt];
     r_lo = r_gp[m_ins.i.rs] / r_gp[m_ins.i.rt];
-    if (r_gp[m_ins.i.rt])
-        setInsDelay( ::soclib::common::clz(r_gp[m_ins.i.rt])+1 );
+    mduIssue( ::soclib::common::clz(r_gp[m_ins.i.rt])+1 );
 }
 
-void Mips32Iss::special_add()
+tmpl(void)::special_add()
 {
     uint64_t tmp = (uint64_t)r_gp[m_ins.i.rs] + (uint64_t)r_gp[m_ins.i.rt];
     if ( overflow( r_gp[m_ins.i.rs], r_gp[m_ins.i.rt], 0 ) )
@@ -222,12 +226,12 @@ void Mips32Iss::special_add()
         r_gp[m_ins.r.rd] = tmp;
 }
 
-void Mips32Iss::special_addu()
+tmpl(void)::special_addu()
 {
     r_gp[m_ins.r.rd] = r_gp[m_ins.i.rs] + r_gp[m_ins.i.rt];
 }
 
-void Mips32Iss::special_sub()
+tmpl(void)::special_sub()
 {
     uint64_t tmp = (uint64_t)r_gp[m_ins.i.rs] - (uint64_t)r_gp[m_ins.i.rt];
     if ( overflow( ~r_gp[m_ins.i.rt], r_gp[m_ins.i.rs], 1 ) )
@@ -236,83 +240,92 @@ void Mips32Iss::special_sub()
         r_gp[m_ins.r.rd] = tmp;
 }
 
-void Mips32Iss::special_subu()
+tmpl(void)::special_subu()
 {
     r_gp[m_ins.r.rd] = r_gp[m_ins.i.rs] - r_gp[m_ins.i.rt];
 }
 
-void Mips32Iss::special_and()
+tmpl(void)::special_and()
 {
     r_gp[m_ins.r.rd] = r_gp[m_ins.i.rs] & r_gp[m_ins.i.rt];
 }
 
-void Mips32Iss::special_or()
+tmpl(void)::special_or()
 {
     r_gp[m_ins.r.rd] = r_gp[m_ins.i.rs] | r_gp[m_ins.i.rt];
 }
 
-void Mips32Iss::special_xor()
+tmpl(void)::special_xor()
 {
     r_gp[m_ins.r.rd] = r_gp[m_ins.i.rs] ^ r_gp[m_ins.i.rt];
 }
 
-void Mips32Iss::special_nor()
+tmpl(void)::special_nor()
 {
     r_gp[m_ins.r.rd] = ~(r_gp[m_ins.i.rs] | r_gp[m_ins.i.rt]);
 }
 
-void Mips32Iss::special_slt()
+tmpl(void)::special_slt()
 {
     r_gp[m_ins.r.rd] = (bool)((int32_t)r_gp[m_ins.i.rs] < (int32_t)r_gp[m_ins.i.rt]);
 }
 
-void Mips32Iss::special_sltu()
+tmpl(void)::special_sltu()
 {
     r_gp[m_ins.r.rd] = (bool)(r_gp[m_ins.i.rs] < r_gp[m_ins.i.rt]);
 }
 
-void Mips32Iss::special_tlt()
+tmpl(void)::special_tlt()
 {
     if ((int32_t)r_gp[m_ins.i.rs] < (int32_t)r_gp[m_ins.i.rt])
         m_exception = X_TR;
 }
 
-void Mips32Iss::special_tltu()
+tmpl(void)::special_tltu()
 {
     if (r_gp[m_ins.i.rs] < r_gp[m_ins.i.rt])
         m_exception = X_TR;
 }
 
-void Mips32Iss::special_tge()
+tmpl(void)::special_tge()
 {
     if ((int32_t)r_gp[m_ins.i.rs] >= (int32_t)r_gp[m_ins.i.rt])
         m_exception = X_TR;
 }
 
-void Mips32Iss::special_tgeu()
+tmpl(void)::special_tgeu()
 {
     if (r_gp[m_ins.i.rs] >= r_gp[m_ins.i.rt])
         m_exception = X_TR;
 }
 
-void Mips32Iss::special_teq()
+tmpl(void)::special_teq()
 {
     if (r_gp[m_ins.i.rs] == r_gp[m_ins.i.rt])
         m_exception = X_TR;
 }
 
-void Mips32Iss::special_tne()
+tmpl(void)::special_tne()
 {
     if (r_gp[m_ins.i.rs] != r_gp[m_ins.i.rt])
         m_exception = X_TR;
 }
 
-void Mips32Iss::special_sync()
+tmpl(void)::special_sync()
 {
     do_mem_access(4*XTN_SYNC, 4, 0, 0, 0, 0, XTN_READ);
 }
 
-void Mips32Iss::special_ill()
+// movf/movt, on FPU condition codes
+tmpl(void)::special_movci()
+{
+    if ( ! fpuUsable() )
+        return;
+    if ( fpuCondition(m_ins.r.rt >> 2) == (bool)(m_ins.r.rt & 1) )
+        r_gp[m_ins.r.rd] = r_gp[m_ins.r.rs];
+}
+
+tmpl(void)::special_ill()
 {
     m_exception = X_RI;
 }
@@ -320,8 +333,8 @@ void Mips32Iss::special_ill()
 #define op(x) &Mips32Iss::special_##x
 #define op4(x, y, z, t) op(x), op(y), op(z), op(t)
 
-Mips32Iss::func_t const Mips32Iss::special_table[] = {
-        op4(  sll,  ill,  srl,  sra),
+tmpl(typename Mips32Iss<little_endian, Observer>::func_t const)::special_table[] = {
+        op4(  sll,movci,  srl,  sra),
         op4( sllv,  ill, srlv, srav),
 
         op4(   jr, jalr, movz, movn),
@@ -349,12 +362,54 @@ Mips32Iss::func_t const Mips32Iss::special_table[] = {
 #undef op
 #undef op4
 
-void Mips32Iss::op_special()
+tmpl(void)::op_special()
 {
     func_t func = special_table[m_ins.r.func];
     (this->*func)();
 }
 
+MIPS32_INSTANTIATE(void, special_sll())
+MIPS32_INSTANTIATE(void, special_srl())
+MIPS32_INSTANTIATE(void, special_sra())
+MIPS32_INSTANTIATE(void, special_sllv())
+MIPS32_INSTANTIATE(void, special_srlv())
+MIPS32_INSTANTIATE(void, special_srav())
+MIPS32_INSTANTIATE(void, special_jr())
+MIPS32_INSTANTIATE(void, special_jalr())
+MIPS32_INSTANTIATE(void, special_sysc())
+MIPS32_INSTANTIATE(void, special_brek())
+MIPS32_INSTANTIATE(void, special_mfhi())
+MIPS32_INSTANTIATE(void, special_movn())
+MIPS32_INSTANTIATE(void, special_movz())
+MIPS32_INSTANTIATE(void, special_mthi())
+MIPS32_INSTANTIATE(void, special_mflo())
+MIPS32_INSTANTIATE(void, special_mtlo())
+MIPS32_INSTANTIATE(void, special_mult())
+MIPS32_INSTANTIATE(void, special_multu())
+MIPS32_INSTANTIATE(void, special_div())
+MIPS32_INSTANTIATE(void, special_divu())
+MIPS32_INSTANTIATE(void, special_add())
+MIPS32_INSTANTIATE(void, special_addu())
+MIPS32_INSTANTIATE(void, special_sub())
+MIPS32_INSTANTIATE(void, special_subu())
+MIPS32_INSTANTIATE(void, special_and())
+MIPS32_INSTANTIATE(void, special_or())
+MIPS32_INSTANTIATE(void, special_xor())
+MIPS32_INSTANTIATE(void, special_nor())
+MIPS32_INSTANTIATE(void, special_slt())
+MIPS32_INSTANTIATE(void, special_sltu())
+MIPS32_INSTANTIATE(void, special_tlt())
+MIPS32_INSTANTIATE(void, special_tltu())
+MIPS32_INSTANTIATE(void, special_tge())
+MIPS32_INSTANTIATE(void, special_tgeu())
+MIPS32_INSTANTIATE(void, special_teq())
+MIPS32_INSTANTIATE(void, special_tne())
+MIPS32_INSTANTIATE(void, special_sync())
+MIPS32_INSTANTIATE(void, special_movci())
+MIPS32_INSTANTIATE(void, special_ill())
+MIPS32_INSTANTIATE_NESTED(func_t const, special_table[64])
+MIPS32_INSTANTIATE(void, op_special())
+
 }}
 
 // Local Variables:
@@ -29,88 +29,133 @@
  */
 
 #include "mips32.h"
-#include "base_module.h"
 #include "arithmetics.h"
 
 #include <strings.h>
 
 namespace soclib { namespace common {
 
-void Mips32Iss::op_special2()
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
+tmpl(void)::special2_madd()
+{
+    int64_t tmp = ((int64_t)r_hi)<<32 | (int64_t)r_lo;
+    tmp += (int64_t)r_gp[m_ins.i.rs]*(int64_t)r_gp[m_ins.i.rt];
+    r_hi = tmp>>32;
+    r_lo = tmp;
+    mduIssue( r_gp[m_ins.i.rt] ? 6 : 0 );
+}
+
+tmpl(void)::special2_maddu()
+{
+    uint64_t tmp = ((uint64_t)r_hi)<<32 | (uint64_t)r_lo;
+    tmp += (uint64_t)r_gp[m_ins.i.rs]*(uint64_t)r_gp[m_ins.i.rt];
+    r_hi = tmp>>32;
+    r_lo = tmp;
+    mduIssue( r_gp[m_ins.i.rt] ? 6 : 0 );
+}
+
+tmpl(void)::special2_mul()
+{
+    // Result goes to a general register, which is not scoreboarded:
+    // the core waits for the unit, then for the result.
+    uint32_t delay = m_mdu_delay + (r_gp[m_ins.i.rt] ? 3 : 1);
+    r_gp[m_ins.r.rd] = r_gp[m_ins.i.rs]*r_gp[m_ins.i.rt];
+    if ( delay > 1 )
+        setInsDelay( delay );
+}
+
+tmpl(void)::special2_msub()
 {
-    enum {
-        MADD = 0,
-        MADDU = 1,
-        MUL = 2,
-        MSUB = 4,
-        MSUBU = 5,
-        CLZ = 0x20,
-        CLO = 0x21,
-    };
-
-    switch ( m_ins.r.func ) {
-    case MUL:
-        r_gp[m_ins.r.rd] = r_gp[m_ins.i.rs]*r_gp[m_ins.i.rt];
-        if (r_gp[m_ins.i.rt])
-            setInsDelay( 3 );
-        break;
-    case MSUB: {
-        int64_t tmp = ((int64_t)r_hi)<<32 | (int64_t)r_lo;
-        tmp -= (int64_t)r_gp[m_ins.i.rs]*(int64_t)r_gp[m_ins.i.rt];
-        r_hi = tmp>>32;
-        r_lo = tmp;
-        if (r_gp[m_ins.i.rt])
-            setInsDelay( 6 );
-        break;
-    }
-    case MSUBU: {
-        uint64_t tmp = ((uint64_t)r_hi)<<32 | (uint64_t)r_lo;
-        tmp -= (uint64_t)r_gp[m_ins.i.rs]*(uint64_t)r_gp[m_ins.i.rt];
-        r_hi = tmp>>32;
-        r_lo = tmp;
-        if (r_gp[m_ins.i.rt])
-            setInsDelay( 6 );
-        break;
-    }
-    case MADD: {
-        int64_t tmp = ((int64_t)r_hi)<<32 | (int64_t)r_lo;
-        tmp += (int64_t)r_gp[m_ins.i.rs]*(int64_t)r_gp[m_ins.i.rt];
-        r_hi = tmp>>32;
-        r_lo = tmp;
-        if (r_gp[m_ins.i.rt])
-            setInsDelay( 6 );
-        break;
-    }
-    case MADDU: {
-        uint64_t tmp = ((uint64_t)r_hi)<<32 | (uint64_t)r_lo;
-        tmp += (uint64_t)r_gp[m_ins.i.rs]*(uint64_t)r_gp[m_ins.i.rt];
-        r_hi = tmp>>32;
-        r_lo = tmp;
-        if (r_gp[m_ins.i.rt])
-            setInsDelay( 6 );
-        break;
-    }
-    case CLO: {
-        if ( m_ins.r.rt != m_ins.r.rd ) {
-            // Unpredictable result, as in spec
-            m_exception = X_TR;
-        } else {
-            r_gp[m_ins.r.rt] = soclib::common::clo(r_gp[m_ins.r.rs]);
-        }
-    }
-    case CLZ: {
-        if ( m_ins.r.rt != m_ins.r.rd ) {
-            // Unpredictable result, as in spec
-            m_exception = X_TR;
-        } else {
-            r_gp[m_ins.r.rt] = soclib::common::clz(r_gp[m_ins.r.rs]);
-        }
-    }
-    default:
-        op_ill();
-    }
+    int64_t tmp = ((int64_t)r_hi)<<32 | (int64_t)r_lo;
+    tmp -= (int64_t)r_gp[m_ins.i.rs]*(int64_t)r_gp[m_ins.i.rt];
+    r_hi = tmp>>32;
+    r_lo = tmp;
+    mduIssue( r_gp[m_ins.i.rt] ? 6 : 0 );
 }
 
+tmpl(void)::special2_msubu()
+{
+    uint64_t tmp = ((uint64_t)r_hi)<<32 | (uint64_t)r_lo;
+    tmp -= (uint64_t)r_gp[m_ins.i.rs]*(uint64_t)r_gp[m_ins.i.rt];
+    r_hi = tmp>>32;
+    r_lo = tmp;
+    mduIssue( r_gp[m_ins.i.rt] ? 6 : 0 );
+}
+
+tmpl(void)::special2_clz()
+{
+    // rt != rd is unpredictable, we simply write rd
+    r_gp[m_ins.r.rd] = soclib::common::clz(r_gp[m_ins.r.rs]);
+}
+
+tmpl(void)::special2_clo()
+{
+    r_gp[m_ins.r.rd] = soclib::common::clo(r_gp[m_ins.r.rs]);
+}
+
+// There is no EJTAG debug mode, software debug breakpoints are taken
+// as plain breakpoints, where the debugger expects them.
+tmpl(void)::special2_sdbbp()
+{
+    m_exception = X_BP;
+}
+
+tmpl(void)::special2_ill()
+{
+    m_exception = X_RI;
+}
+
+#define op(x) &Mips32Iss::special2_##x
+#define op4(x, y, z, t) op(x), op(y), op(z), op(t)
+
+tmpl(typename Mips32Iss<little_endian, Observer>::func_t const)::special2_table[] = {
+        op4( madd,maddu,  mul,  ill),
+        op4( msub,msubu,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  clz,  clo,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,sdbbp),
+};
+
+#undef op
+#undef op4
+
+tmpl(void)::op_special2()
+{
+    func_t func = special2_table[m_ins.r.func];
+    (this->*func)();
+}
+
+MIPS32_INSTANTIATE(void, special2_madd())
+MIPS32_INSTANTIATE(void, special2_maddu())
+MIPS32_INSTANTIATE(void, special2_mul())
+MIPS32_INSTANTIATE(void, special2_msub())
+MIPS32_INSTANTIATE(void, special2_msubu())
+MIPS32_INSTANTIATE(void, special2_clz())
+MIPS32_INSTANTIATE(void, special2_clo())
+MIPS32_INSTANTIATE(void, special2_sdbbp())
+MIPS32_INSTANTIATE(void, special2_ill())
+MIPS32_INSTANTIATE_NESTED(func_t const, special2_table[64])
+MIPS32_INSTANTIATE(void, op_special2())
+
 }}
 
 // Local Variables:
@@ -29,93 +29,138 @@
  */
 
 #include "mips32.h"
-#include "base_module.h"
 #include "arithmetics.h"
 #include "soclib_endian.h"
 
 namespace soclib { namespace common {
 
-void Mips32Iss::op_special3()
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
+tmpl(void)::special3_ext()
 {
-    enum {
-        EXT = 0,
-		INS = 0x4,
-		BSHFL = 0x20,
-		RDHWR = 0x3b,
-    };
+    size_t size = m_ins.r.rd + 1;
+    size_t lsb = m_ins.r.sh;
+    r_gp[m_ins.r.rt] = extract_bits(r_gp[m_ins.r.rs], lsb, size);
+}
+
+tmpl(void)::special3_ins()
+{
+    size_t lsb = m_ins.r.sh;
+    size_t msb = m_ins.r.rd;
+    r_gp[m_ins.r.rt] = insert_bits(r_gp[m_ins.r.rt], r_gp[m_ins.r.rs], lsb, msb-lsb+1);
+}
 
+tmpl(void)::special3_bshfl()
+{
 	enum {
 		SEB = 0x10,
 		SEH = 0x18,
 		WSBH = 0x2,
 	};
 
+    switch ( m_ins.r.sh ) {
+    case SEB:
+        r_gp[m_ins.r.rd] = sign_ext8(r_gp[m_ins.r.rt]);
+        break;
+    case SEH:
+        r_gp[m_ins.r.rd] = sign_ext16(r_gp[m_ins.r.rt]);
+        break;
+    case WSBH:
+        r_gp[m_ins.r.rd] = soclib::endian::uint32_swap16(r_gp[m_ins.r.rt]);
+        break;
+    default:
+        op_ill();
+    }
+}
+
+tmpl(void)::special3_rdhwr()
+{
     enum {
         RDHWR_CPUNUM = 0,
+        RDHWR_SYNCI_STEP = 1,
         RDHWR_CC = 2,
         RDHWR_CCRES = 3,
         RDHWR_TLS = 29,
     };
 
-    switch ( m_ins.r.func ) {
-    case EXT: {
-		size_t size = m_ins.r.rd + 1;
-		size_t lsb = m_ins.r.sh;
-        r_gp[m_ins.r.rt] = extract_bits(r_gp[m_ins.r.rs], lsb, size);
-        break;
+    if ( r_cpu_mode == MIPS32_USER &&
+         ! ( r_hwrena & (1<<m_ins.r.rd) ) ) {
+        m_exception = X_RI;
+        return;
     }
-    case RDHWR:
-        if ( r_cpu_mode == MIPS32_USER &&
-             ! ( r_hwrena & (1<<m_ins.r.rd) ) ) {
-            m_exception = X_RI;
-            break;
-        }
-        switch (m_ins.r.rd) {
-        case RDHWR_CPUNUM:
-            r_gp[m_ins.r.rt] = m_ident;
-            break;
-        case RDHWR_CC:
-            r_gp[m_ins.r.rt] = r_count;
-            break;
-        case RDHWR_CCRES:
-            r_gp[m_ins.r.rt] = 1;
-            break;
-        case RDHWR_TLS:
-            r_gp[m_ins.r.rt] = r_tls_base;
-            break;
-        default:
-            m_exception = X_RI;
-            break;
-        }
+    switch (m_ins.r.rd) {
+    case RDHWR_CPUNUM:
+        r_gp[m_ins.r.rt] = m_ident;
+        break;
+    case RDHWR_SYNCI_STEP:
+        r_gp[m_ins.r.rt] = m_icache_line_size;
+        break;
+    case RDHWR_CC:
+        r_gp[m_ins.r.rt] = r_count;
         break;
-    case INS: {
-		size_t lsb = m_ins.r.sh;
-		size_t msb = m_ins.r.rd;
-        r_gp[m_ins.r.rt] = insert_bits(r_gp[m_ins.r.rt], r_gp[m_ins.r.rs], lsb, msb-lsb+1);
+    case RDHWR_CCRES:
+        r_gp[m_ins.r.rt] = 1;
         break;
-	}
-	case BSHFL: {
-		switch ( m_ins.r.sh ) {
-		case SEB:
-			r_gp[m_ins.r.rd] = sign_ext8(r_gp[m_ins.r.rt]);
-			break;
-		case SEH:
-			r_gp[m_ins.r.rd] = sign_ext16(r_gp[m_ins.r.rt]);
-			break;
-		case WSBH: {
-			r_gp[m_ins.r.rd] = soclib::endian::uint32_swap16(r_gp[m_ins.r.rt]);
-			break;
-		}
-        default:
-            op_ill();
-		}
+    case RDHWR_TLS:
+        r_gp[m_ins.r.rt] = r_tls_base;
         break;
-	}
     default:
-        op_ill();
+        m_exception = X_RI;
+        break;
     }
 }
 
+tmpl(void)::special3_ill()
+{
+    m_exception = X_RI;
+}
+
+#define op(x) &Mips32Iss::special3_##x
+#define op4(x, y, z, t) op(x), op(y), op(z), op(t)
+
+tmpl(typename Mips32Iss<little_endian, Observer>::func_t const)::special3_table[] = {
+        op4(  ext,  ill,  ill,  ill),
+        op4(  ins,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(bshfl,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,  ill),
+        op4(  ill,  ill,  ill,  ill),
+
+        op4(  ill,  ill,  ill,rdhwr),
+        op4(  ill,  ill,  ill,  ill),
+};
+
+#undef op
+#undef op4
+
+tmpl(void)::op_special3()
+{
+    func_t func = special3_table[m_ins.r.func];
+    (this->*func)();
+}
+
+MIPS32_INSTANTIATE(void, special3_ext())
+MIPS32_INSTANTIATE(void, special3_ins())
+MIPS32_INSTANTIATE(void, special3_bshfl())
+MIPS32_INSTANTIATE(void, special3_rdhwr())
+MIPS32_INSTANTIATE(void, special3_ill())
+MIPS32_INSTANTIATE_NESTED(func_t const, special3_table[64])
+MIPS32_INSTANTIATE(void, op_special3())
+
 }}
 
 // Local Variables:
@@ -0,0 +1,184 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "mips32.h"
+
+#include <cstring>
+
+namespace soclib { namespace common {
+
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
+// Polling loops are recognized by their fixed point: an iteration
+// starting and ending at the same head, with the same general
+// registers, hi and lo, only reading memory (not device registers,
+// see spinMayLoad()). Anything else it could
+// depend on is either read memory, coprocessor state (Count, Random,
+// FPU registers...), or some side effect, which disqualify the
+// iteration. Given the same memory, the next iterations are the same.
+//
+// Iterations are delimited by taken backward branches or jumps, the
+// check happens when the branch target is about to run, once its
+// delay slot and all the pending loads are done.
+
+tmpl(void)::setSpinDetection( bool enabled )
+{
+    m_spin_detection = enabled;
+    m_spinning = false;
+    spinForget();
+}
+
+tmpl(bool)::addSpinRange( addr_t base, size_t size )
+{
+    if ( m_spin_range_count == SPIN_MAX_RANGES || size < 4 )
+        return false;
+
+    struct SpinRange &r = m_spin_ranges[m_spin_range_count++];
+    r.base = base;
+    r.size = size;
+    return true;
+}
+
+// Loads from anything else than memory may change without a write
+// anybody could snoop
+tmpl(bool)::spinMayLoad( addr_t addr ) const
+{
+    if ( dmiPtr( addr, DMI_READ ) )
+        return true;
+    for ( size_t i = 0; i < m_spin_range_count; ++i ) {
+        const struct SpinRange &r = m_spin_ranges[i];
+        if ( (size_t)(addr - r.base) <= r.size - 4 )
+            return true;
+    }
+    return false;
+}
+
+tmpl(void)::spinForget()
+{
+    m_spin_closing = false;
+    // Never a valid pc
+    m_spin_head = 1;
+    m_spin_clean = false;
+    m_spin_ins = 0;
+    m_spin_loads = 0;
+}
+
+tmpl(bool)::spinCheck()
+{
+    if ( ! m_spin_closing || r_pc != m_spin_target )
+        return false;
+    m_spin_closing = false;
+
+    if ( m_spin_clean && m_spin_head == r_pc
+         && r_hi == m_spin_regs[32] && r_lo == m_spin_regs[33]
+         && ! std::memcmp( r_gp, m_spin_regs, sizeof(r_gp) ) ) {
+        // Loads of the last iteration are the ones to watch
+        m_spinning = true;
+        return true;
+    }
+
+    m_spin_head = r_pc;
+    std::memcpy( m_spin_regs, r_gp, sizeof(r_gp) );
+    m_spin_regs[32] = r_hi;
+    m_spin_regs[33] = r_lo;
+    m_spin_clean = true;
+    m_spin_ins = 0;
+    m_spin_loads = 0;
+    return false;
+}
+
+tmpl(void)::spinRetire()
+{
+    if ( m_exception != NO_EXCEPTION ) {
+        spinForget();
+        return;
+    }
+
+    if ( m_next_pc != r_npc+4 && m_next_pc <= r_pc ) {
+        m_spin_closing = true;
+        m_spin_target = m_next_pc;
+    }
+
+    if ( ! m_spin_clean )
+        return;
+
+    const uint32_t op = m_ins.i.op;
+    bool clean = ++m_spin_ins <= SPIN_MAX_INS
+        // cop0, cop1, cop2, cop1x
+        && (op < 0x10 || op > 0x13)
+        // FPU loads and stores
+        && (op & 0x33) != 0x31
+        // rdhwr (Count, among others)
+        && ! (op == 0x1f && m_ins.r.func == 0x3b);
+
+    if ( clean && m_dreq.valid ) {
+        if ( (m_dreq.type == DATA_READ || m_dreq.type == DATA_LL)
+             && m_spin_loads < SPIN_MAX_LOADS
+             && spinMayLoad( m_dreq.addr & ~3 ) )
+            m_spin_load_addr[m_spin_loads++] = m_dreq.addr & ~3;
+        else
+            clean = false;
+    }
+    m_spin_clean = clean;
+}
+
+tmpl(void)::snoopWrite( addr_t base, size_t size )
+{
+    for ( uint32_t i = 0; i < m_spin_loads; ++i ) {
+        addr_t addr = m_spin_load_addr[i];
+        if ( addr - base < size || base - addr < 4 ) {
+#ifdef SOCLIB_MODULE_DEBUG
+            std::cout << name() << " polled word written @" << addr << std::endl;
+#endif
+            m_spinning = false;
+            m_spin_clean = false;
+            return;
+        }
+    }
+}
+
+MIPS32_INSTANTIATE(void, setSpinDetection( bool enabled ))
+MIPS32_INSTANTIATE(bool, addSpinRange( addr_t base, size_t size ))
+MIPS32_INSTANTIATE(bool, spinMayLoad( addr_t addr ) const)
+MIPS32_INSTANTIATE(void, spinForget())
+MIPS32_INSTANTIATE(bool, spinCheck())
+MIPS32_INSTANTIATE(void, spinRetire())
+MIPS32_INSTANTIATE(void, snoopWrite( addr_t base, size_t size ))
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,312 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "mips32.h"
+
+#include <cstring>
+#include <vector>
+
+namespace soclib { namespace common {
+
+#define tmpl(...) template<bool little_endian, typename Observer> __VA_ARGS__ Mips32Iss<little_endian, Observer>
+
+// State blob is a header, then a fixed sequence of 32-bit little
+// endian words, in stateTransfer() order:
+//  - "M32S" magic
+//  - STATE_VERSION
+//  - core endianness (1 for little endian)
+//  - word count
+//  - words
+//
+// Platform settings (Config registers, spin detection, ...) are not
+// part of the state. Index-like fields are range checked on restore,
+// the whole blob is checked before any of it is applied.
+
+namespace {
+
+const char state_magic[4] = { 'M', '3', '2', 'S' };
+
+void put32( std::ostream &o, uint32_t v )
+{
+    char b[4];
+    for ( size_t i = 0; i < 4; ++i )
+        b[i] = v >> (8*i);
+    o.write(b, 4);
+}
+
+bool get32( std::istream &is, uint32_t &v )
+{
+    unsigned char b[4];
+    if ( ! is.read((char*)b, 4) )
+        return false;
+    v = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+    return true;
+}
+
+class StateCounter
+{
+public:
+    size_t m_count;
+
+    StateCounter()
+        : m_count(0)
+    {}
+
+    void word( uint32_t &, uint32_t = 0 )
+    {
+        ++m_count;
+    }
+};
+
+class StateWriter
+{
+    std::ostream &m_o;
+
+public:
+    StateWriter( std::ostream &o )
+        : m_o(o)
+    {}
+
+    void word( uint32_t &v, uint32_t = 0 )
+    {
+        put32(m_o, v);
+    }
+};
+
+// Leaves the state untouched, only checks the blob words against
+// their limit
+class StateChecker
+{
+    std::vector<uint32_t>::const_iterator m_next;
+
+public:
+    bool m_ok;
+
+    StateChecker( const std::vector<uint32_t> &words )
+        : m_next(words.begin()),
+          m_ok(true)
+    {}
+
+    void word( uint32_t &, uint32_t limit = 0 )
+    {
+        uint32_t v = *m_next++;
+        if ( limit && v >= limit )
+            m_ok = false;
+    }
+};
+
+class StateReader
+{
+    std::vector<uint32_t>::const_iterator m_next;
+
+public:
+    StateReader( const std::vector<uint32_t> &words )
+        : m_next(words.begin())
+    {}
+
+    void word( uint32_t &v, uint32_t = 0 )
+    {
+        v = *m_next++;
+    }
+};
+
+// `limit', if any, is the exclusive upper bound of valid values
+template<typename Archive, typename T>
+void field( Archive &a, T &v, uint32_t limit = 0 )
+{
+    uint32_t w = (uint32_t)v;
+    a.word(w, limit);
+    v = (T)w;
+}
+
+// Low word first
+template<typename Archive>
+void field64( Archive &a, uint64_t &v )
+{
+    uint32_t lo = (uint32_t)v;
+    uint32_t hi = (uint32_t)(v >> 32);
+    a.word(lo);
+    a.word(hi);
+    v = ((uint64_t)hi << 32) | lo;
+}
+
+}
+
+tmpl(template<typename Archive> void)::stateTransfer( Archive &a )
+{
+    field(a, r_pc);
+    field(a, r_npc);
+    for ( size_t i = 0; i < 32; ++i )
+        field(a, r_gp[i]);
+    field(a, r_hi);
+    field(a, r_lo);
+
+    field(a, m_dreq.valid);
+    field(a, m_dreq.addr);
+    field(a, m_dreq.wdata);
+    field(a, m_dreq.type, XTN_READ + 1);
+    field(a, m_dreq.be, 0x10);
+    field(a, m_dreq.mode, MODE_USER + 1);
+    field(a, r_mem_do_sign_extend);
+    field(a, r_mem_byte_le, 4);
+    field(a, r_mem_byte_count, 5);
+    field(a, r_mem_offset_byte_in_reg, 4);
+    field(a, r_mem_dest, MEM_DEST_FPR + 32);
+    field(a, r_mem_pair);
+    field(a, r_mem_pair_addr);
+    field(a, r_mem_pair_dest, MEM_DEST_FPR + 32);
+    field(a, r_mem_pair_wdata);
+    field(a, m_dmi_dreq);
+    field(a, m_dmi_drsp.valid);
+    field(a, m_dmi_drsp.error);
+    field(a, m_dmi_drsp.rdata);
+
+    field(a, m_ibe);
+    field(a, m_dbe);
+    field(a, m_skip_next_instruction);
+    field(a, m_ins_delay);
+    field(a, m_mdu_delay);
+    field(a, m_random);
+    field(a, m_sleeping);
+    field(a, m_spinning);
+    field(a, m_spin_closing);
+    field(a, m_spin_target);
+    field(a, m_spin_head);
+    for ( size_t i = 0; i < SPIN_REGS; ++i )
+        field(a, m_spin_regs[i]);
+    field(a, m_spin_clean);
+    field(a, m_spin_ins);
+    field(a, m_spin_loads, SPIN_MAX_LOADS + 1);
+    for ( size_t i = 0; i < SPIN_MAX_LOADS; ++i )
+        field(a, m_spin_load_addr[i]);
+    field(a, m_spin_cycles);
+    field(a, m_hazard);
+    field(a, m_functional);
+    field(a, m_ireq_ok);
+    field(a, m_dreq_ok);
+    field(a, m_ins.ins);
+    field(a, m_exec_cycles);
+    field64(a, m_cycles);
+    field(a, r_bus_mode, MODE_USER + 1);
+    field(a, r_cpu_mode, MIPS32_USER + 1);
+
+    field(a, r_status.whole);
+    field(a, r_cause.whole);
+    field(a, r_ebase);
+    field(a, r_bar);
+    field(a, r_epc);
+    field(a, r_error_epc);
+    field(a, r_count);
+    field(a, r_compare);
+    field(a, r_intctl.whole);
+    field(a, r_hwrena);
+    field(a, r_tls_base);
+    for ( size_t i = 0; i < 32; ++i )
+        field(a, r_fpr[i]);
+    field(a, r_fcsr.whole);
+    field(a, m_unusable_cop, 4);
+    for ( size_t i = 0; i < PERF_COUNTERS; ++i ) {
+        field(a, r_perfctl[i].whole);
+        field(a, r_perfcnt[i]);
+    }
+}
+
+tmpl(bool)::stateSave( std::ostream &o ) const
+{
+    Mips32Iss *self = const_cast<Mips32Iss*>(this);
+    StateCounter counter;
+    StateWriter writer(o);
+
+    self->stateTransfer(counter);
+
+    o.write(state_magic, sizeof(state_magic));
+    put32(o, STATE_VERSION);
+    put32(o, little_endian);
+    put32(o, counter.m_count);
+    self->stateTransfer(writer);
+    return !!o;
+}
+
+tmpl(bool)::stateRestore( std::istream &is )
+{
+    char magic[sizeof(state_magic)];
+    uint32_t version, endianness, count;
+    StateCounter counter;
+
+    stateTransfer(counter);
+
+    if ( ! is.read(magic, sizeof(magic))
+         || std::memcmp(magic, state_magic, sizeof(magic))
+         || ! get32(is, version) || version != STATE_VERSION
+         || ! get32(is, endianness) || endianness != little_endian
+         || ! get32(is, count) || count != counter.m_count )
+        return false;
+
+    // Only touch the state once the whole blob is read and checked
+    std::vector<uint32_t> words(count);
+    for ( size_t i = 0; i < count; ++i )
+        if ( ! get32(is, words[i]) )
+            return false;
+
+    StateChecker checker(words);
+    stateTransfer(checker);
+    if ( ! checker.m_ok )
+        return false;
+
+    StateReader reader(words);
+    stateTransfer(reader);
+
+    // Derived state
+    decodeCacheFlush();
+    m_decoded = decode( r_pc, m_ins.ins );
+    perfUpdate();
+    // Spin detection is a platform setting, not part of the state
+    if ( ! m_spin_detection ) {
+        m_spinning = false;
+        spinForget();
+    }
+    if ( m_timing )
+        m_timing->reset();
+    return true;
+}
+
+MIPS32_INSTANTIATE(bool, stateSave( std::ostream &o ) const)
+MIPS32_INSTANTIATE(bool, stateRestore( std::istream &is ))
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,520 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "mips32_timing.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace soclib { namespace common {
+
+namespace {
+
+const char *const class_names[] = {
+    "alu", "load", "store", "branch",
+    "mfhilo", "mthilo", "mult", "mul", "madd", "div",
+    "fp_move", "fp_add", "fp_mul", "fp_madd", "fp_cvt", "fp_cmp",
+    "fp_div_s", "fp_div_d", "fp_sqrt_s", "fp_sqrt_d",
+    "other",
+};
+
+// Default latency and repeat rate of each class
+const uint32_t default_latency[][2] = {
+    { 1, 1 },   // alu
+    { 2, 1 },   // load
+    { 1, 1 },   // store
+    { 1, 1 },   // branch
+    { 1, 1 },   // mfhilo
+    { 1, 1 },   // mthilo
+    { 3, 1 },   // mult
+    { 3, 1 },   // mul
+    { 6, 1 },   // madd
+    { 33, 33 }, // div
+    { 1, 1 },   // fp_move
+    { 4, 1 },   // fp_add
+    { 5, 1 },   // fp_mul
+    { 9, 1 },   // fp_madd
+    { 4, 1 },   // fp_cvt
+    { 2, 1 },   // fp_cmp
+    { 12, 12 }, // fp_div_s
+    { 25, 25 }, // fp_div_d
+    { 12, 12 }, // fp_sqrt_s
+    { 25, 25 }, // fp_sqrt_d
+    { 1, 1 },   // other
+};
+
+}
+
+Mips32TimingModel::~Mips32TimingModel()
+{
+}
+
+Mips32PipelineModel::Mips32PipelineModel()
+    : m_ex_forwarding(true),
+      m_mem_forwarding(true),
+      m_branch_penalty(0),
+      m_branch_in_id(false),
+      m_stall_cycles(0)
+{
+    for ( size_t i = 0; i < OP_CLASS_COUNT; ++i ) {
+        m_latency[i] = default_latency[i][0];
+        m_repeat[i] = default_latency[i][1];
+    }
+    for ( size_t i = 0; i < DECODE_CACHE_SIZE; ++i ) {
+        // Never a valid pc
+        m_decode_cache[i].pc = 1;
+        m_decode_cache[i].ins = 0;
+    }
+    reset();
+}
+
+void Mips32PipelineModel::reset()
+{
+    m_fresh = true;
+}
+
+const char *Mips32PipelineModel::className( enum OpClass op )
+{
+    return class_names[op];
+}
+
+void Mips32PipelineModel::setLatency( enum OpClass op, uint32_t latency, uint32_t repeat )
+{
+    m_latency[op] = latency ? latency : 1;
+    m_repeat[op] = repeat ? repeat : 1;
+}
+
+bool Mips32PipelineModel::loadLatencies( std::istream &i )
+{
+    std::string line;
+
+    while ( std::getline( i, line ) ) {
+        std::istringstream l(line);
+        std::string name;
+        uint32_t latency, repeat = 1;
+
+        if ( ! (l >> name) || name[0] == '#' )
+            continue;
+        if ( ! (l >> latency) )
+            return false;
+        if ( ! (l >> repeat) )
+            repeat = 1;
+
+        size_t op;
+        for ( op = 0; op < OP_CLASS_COUNT; ++op )
+            if ( name == class_names[op] )
+                break;
+        if ( op == OP_CLASS_COUNT )
+            return false;
+        setLatency( (enum OpClass)op, latency, repeat );
+    }
+    return true;
+}
+
+void Mips32PipelineModel::setForwarding( bool ex_ex, bool mem_ex )
+{
+    m_ex_forwarding = ex_ex;
+    m_mem_forwarding = mem_ex;
+}
+
+void Mips32PipelineModel::setBranchPenalty( uint32_t cycles )
+{
+    m_branch_penalty = cycles;
+}
+
+void Mips32PipelineModel::setBranchInId( bool in_id )
+{
+    m_branch_in_id = in_id;
+}
+
+enum Mips32PipelineModel::Unit Mips32PipelineModel::unit( uint32_t op )
+{
+    switch ( op ) {
+    case OP_MULT:
+    case OP_MUL:
+    case OP_MADD:
+    case OP_DIV:
+        return UNIT_MDU;
+    case OP_FP_DIV_S:
+    case OP_FP_DIV_D:
+    case OP_FP_SQRT_S:
+    case OP_FP_SQRT_D:
+        return UNIT_FPDIV;
+    default:
+        return UNIT_NONE;
+    }
+}
+
+uint32_t Mips32PipelineModel::available( uint32_t op ) const
+{
+    uint32_t avail = m_latency[op];
+
+    // Result is produced in EX (or MEM for loads), written back two
+    // cycles later, and read in ID in the same cycle.
+    if ( ! m_ex_forwarding && avail < 2 )
+        avail = 2;
+    if ( ! m_mem_forwarding && avail < 3 )
+        avail = 3;
+    return avail;
+}
+
+void Mips32PipelineModel::decode( struct Decoded &d, uint32_t ins )
+{
+    const uint32_t op = ins >> 26;
+    const uint32_t rs = (ins >> 21) & 0x1f;
+    const uint32_t rt = (ins >> 16) & 0x1f;
+    const uint32_t rd = (ins >> 11) & 0x1f;
+    const uint32_t sa = (ins >> 6) & 0x1f;
+    const uint32_t func = ins & 0x3f;
+
+    d.op = OP_OTHER;
+    d.n_srcs = 0;
+    d.n_dsts = 0;
+    d.late_src = MAX_SRCS;
+
+#define src(r) d.srcs[d.n_srcs++] = (r)
+#define dst(r) do { if ( (r) != 0 ) d.dsts[d.n_dsts++] = (r); } while (0)
+#define fpr(r) (REG_FPR + ((r) >> 1))
+#define late(r) do { d.late_src = d.n_srcs; src(r); } while (0)
+
+    switch ( op ) {
+    case 0x00: // special
+        switch ( func ) {
+        case 0x00: case 0x02: case 0x03: // sll, srl, sra
+            d.op = OP_ALU; src(rt); dst(rd);
+            break;
+        case 0x01: // movci
+            d.op = OP_ALU; src(rs); src(REG_FCC); src(rd); dst(rd);
+            break;
+        case 0x04: case 0x06: case 0x07: // sllv, srlv, srav
+        case 0x20: case 0x21: case 0x22: case 0x23: // add, addu, sub, subu
+        case 0x24: case 0x25: case 0x26: case 0x27: // and, or, xor, nor
+        case 0x2a: case 0x2b: // slt, sltu
+            d.op = OP_ALU; src(rs); src(rt); dst(rd);
+            break;
+        case 0x08: // jr
+            d.op = OP_BRANCH; src(rs);
+            break;
+        case 0x09: // jalr
+            d.op = OP_BRANCH; src(rs); dst(rd);
+            break;
+        case 0x0a: case 0x0b: // movz, movn
+            d.op = OP_ALU; src(rs); src(rt); src(rd); dst(rd);
+            break;
+        case 0x10: // mfhi
+            d.op = OP_MFHILO; src(REG_HI); dst(rd);
+            break;
+        case 0x12: // mflo
+            d.op = OP_MFHILO; src(REG_LO); dst(rd);
+            break;
+        case 0x11: // mthi
+            d.op = OP_MTHILO; src(rs); dst(REG_HI);
+            break;
+        case 0x13: // mtlo
+            d.op = OP_MTHILO; src(rs); dst(REG_LO);
+            break;
+        case 0x18: case 0x19: // mult, multu
+            d.op = OP_MULT; src(rs); src(rt); dst(REG_HI); dst(REG_LO);
+            break;
+        case 0x1a: case 0x1b: // div, divu
+            d.op = OP_DIV; src(rs); src(rt); dst(REG_HI); dst(REG_LO);
+            break;
+        case 0x30: case 0x31: case 0x32: case 0x33: // tge, tgeu, tlt, tltu
+        case 0x34: case 0x36: // teq, tne
+            d.op = OP_ALU; src(rs); src(rt);
+            break;
+        }
+        break;
+
+    case 0x01: // regimm
+        if ( rt < 0x04 ) { // bltz, bgez, bltzl, bgezl
+            d.op = OP_BRANCH; src(rs);
+        } else if ( rt >= 0x10 && rt < 0x14 ) { // bltzal, bgezal, ...
+            d.op = OP_BRANCH; src(rs); dst(31);
+        } else if ( rt >= 0x08 && rt < 0x0f ) { // traps
+            d.op = OP_ALU; src(rs);
+        } else if ( rt == 0x1f ) { // synci
+            src(rs);
+        }
+        break;
+
+    case 0x02: // j
+        d.op = OP_BRANCH;
+        break;
+    case 0x03: // jal
+        d.op = OP_BRANCH; dst(31);
+        break;
+    case 0x04: case 0x05: case 0x14: case 0x15: // beq, bne, beql, bnel
+        d.op = OP_BRANCH; src(rs); src(rt);
+        break;
+    case 0x06: case 0x07: case 0x16: case 0x17: // blez, bgtz, blezl, bgtzl
+        d.op = OP_BRANCH; src(rs);
+        break;
+
+    case 0x08: case 0x09: case 0x0a: case 0x0b: // addi, addiu, slti, sltiu
+    case 0x0c: case 0x0d: case 0x0e: // andi, ori, xori
+        d.op = OP_ALU; src(rs); dst(rt);
+        break;
+    case 0x0f: // lui
+        d.op = OP_ALU; dst(rt);
+        break;
+
+    case 0x10: // cop0
+        switch ( rs ) {
+        case 0x00: case 0x0b: // mfc0, mfmc0
+            d.op = OP_ALU; dst(rt);
+            break;
+        case 0x04: // mtc0
+            d.op = OP_ALU; src(rt);
+            break;
+        case 0x0a: case 0x0e: // rdpgpr, wrpgpr
+            d.op = OP_ALU; src(rt); dst(rd);
+            break;
+        }
+        break;
+
+    case 0x11: // cop1
+        switch ( rs ) {
+        case 0x00: case 0x03: // mfc1, mfhc1
+            d.op = OP_FP_MOVE; src(fpr(rd)); dst(rt);
+            break;
+        case 0x02: // cfc1
+            d.op = OP_FP_MOVE; src(REG_FCC); dst(rt);
+            break;
+        case 0x04: case 0x07: // mtc1, mthc1
+            d.op = OP_FP_MOVE; src(rt); src(fpr(rd)); dst(fpr(rd));
+            break;
+        case 0x06: // ctc1
+            d.op = OP_FP_MOVE; src(rt); dst(REG_FCC);
+            break;
+        case 0x08: // bc1
+            d.op = OP_BRANCH; src(REG_FCC);
+            break;
+        case 0x10: case 0x11: case 0x14: case 0x15: { // s, d, w, l
+            const bool dbl = rs == 0x11 || rs == 0x15;
+            const uint32_t ft = rt, fs = rd, fd = sa;
+
+            if ( func >= 0x30 ) { // c.cond
+                d.op = OP_FP_CMP; src(fpr(fs)); src(fpr(ft)); dst(REG_FCC);
+                break;
+            }
+            switch ( func ) {
+            case 0x00: case 0x01: // add, sub
+                d.op = OP_FP_ADD; src(fpr(fs)); src(fpr(ft));
+                break;
+            case 0x02: // mul
+                d.op = OP_FP_MUL; src(fpr(fs)); src(fpr(ft));
+                break;
+            case 0x03: // div
+                d.op = dbl ? OP_FP_DIV_D : OP_FP_DIV_S; src(fpr(fs)); src(fpr(ft));
+                break;
+            case 0x15: // recip
+                d.op = dbl ? OP_FP_DIV_D : OP_FP_DIV_S; src(fpr(fs));
+                break;
+            case 0x04: case 0x16: // sqrt, rsqrt
+                d.op = dbl ? OP_FP_SQRT_D : OP_FP_SQRT_S; src(fpr(fs));
+                break;
+            case 0x05: case 0x07: // abs, neg
+                d.op = OP_FP_ADD; src(fpr(fs));
+                break;
+            case 0x06: // mov
+                d.op = OP_FP_MOVE; src(fpr(fs));
+                break;
+            case 0x11: // movcf
+                d.op = OP_FP_MOVE; src(fpr(fs)); src(REG_FCC); src(fpr(fd));
+                break;
+            case 0x12: case 0x13: // movz, movn
+                d.op = OP_FP_MOVE; src(fpr(fs)); src(rt); src(fpr(fd));
+                break;
+            default:
+                if ( (func >= 0x08 && func < 0x10) // round, trunc, ceil, floor
+                     || (func >= 0x20 && func < 0x28) ) { // cvt
+                    d.op = OP_FP_CVT; src(fpr(fs));
+                    break;
+                }
+                return;
+            }
+            dst(fpr(fd));
+            break;
+        }
+        }
+        break;
+
+    case 0x12: // cop2
+        switch ( rs ) {
+        case 0x00: case 0x02: // mfc2, cfc2
+            d.op = OP_LOAD; dst(rt);
+            break;
+        case 0x04: case 0x06: // mtc2, ctc2
+            d.op = OP_STORE; late(rt);
+            break;
+        }
+        break;
+
+    case 0x13: // cop1x
+        switch ( func ) {
+        case 0x00: case 0x01: case 0x05: // lwxc1, ldxc1, luxc1
+            d.op = OP_LOAD; src(rs); src(rt); src(fpr(sa)); dst(fpr(sa));
+            break;
+        case 0x08: case 0x09: case 0x0d: // swxc1, sdxc1, suxc1
+            d.op = OP_STORE; src(rs); src(rt); late(fpr(sa));
+            break;
+        case 0x0f: // prefx
+            src(rs); src(rt);
+            break;
+        default:
+            if ( func >= 0x20 ) { // madd, msub, nmadd, nmsub
+                d.op = OP_FP_MADD; src(fpr(rs)); src(fpr(rd)); src(fpr(rt));
+                dst(fpr(sa));
+            }
+            break;
+        }
+        break;
+
+    case 0x1c: // special2
+        switch ( func ) {
+        case 0x00: case 0x01: case 0x04: case 0x05: // madd, maddu, msub, msubu
+            d.op = OP_MADD; src(rs); src(rt); src(REG_HI); src(REG_LO);
+            dst(REG_HI); dst(REG_LO);
+            break;
+        case 0x02: // mul
+            d.op = OP_MUL; src(rs); src(rt); dst(rd);
+            break;
+        case 0x20: case 0x21: // clz, clo
+            d.op = OP_ALU; src(rs); dst(rd);
+            break;
+        }
+        break;
+
+    case 0x1f: // special3
+        switch ( func ) {
+        case 0x00: // ext
+            d.op = OP_ALU; src(rs); dst(rt);
+            break;
+        case 0x04: // ins
+            d.op = OP_ALU; src(rs); src(rt); dst(rt);
+            break;
+        case 0x20: // bshfl
+            d.op = OP_ALU; src(rt); dst(rd);
+            break;
+        case 0x3b: // rdhwr
+            d.op = OP_ALU; dst(rt);
+            break;
+        }
+        break;
+
+    case 0x20: case 0x21: case 0x23: // lb, lh, lw
+    case 0x24: case 0x25: case 0x30: // lbu, lhu, ll
+        d.op = OP_LOAD; src(rs); dst(rt);
+        break;
+    case 0x22: case 0x26: // lwl, lwr
+        d.op = OP_LOAD; src(rs); src(rt); dst(rt);
+        break;
+    case 0x38: // sc
+        d.op = OP_LOAD; src(rs); late(rt); dst(rt);
+        break;
+    case 0x28: case 0x29: case 0x2a: // sb, sh, swl
+    case 0x2b: case 0x2e: // sw, swr
+        d.op = OP_STORE; src(rs); late(rt);
+        break;
+    case 0x31: case 0x35: // lwc1, ldc1
+        d.op = OP_LOAD; src(rs); src(fpr(rt)); dst(fpr(rt));
+        break;
+    case 0x39: case 0x3d: // swc1, sdc1
+        d.op = OP_STORE; src(rs); late(fpr(rt));
+        break;
+    case 0x2f: case 0x33: // cache, pref
+        src(rs);
+        break;
+    }
+
+#undef src
+#undef dst
+#undef fpr
+#undef late
+}
+
+uint32_t Mips32PipelineModel::issue( addr_t pc, uint32_t ins, bool taken, uint64_t now )
+{
+    if ( m_fresh ) {
+        for ( size_t i = 0; i < REG_COUNT; ++i )
+            m_ready[i] = now;
+        for ( size_t i = 0; i < UNIT_COUNT; ++i )
+            m_unit_free[i] = now;
+        m_fresh = false;
+    }
+
+    struct Decoded &d = m_decode_cache[(pc >> 2) % DECODE_CACHE_SIZE];
+    if ( d.pc != pc || d.ins != ins ) {
+        decode( d, ins );
+        d.pc = pc;
+        d.ins = ins;
+    }
+
+    uint64_t at = now;
+    for ( size_t i = 0; i < d.n_srcs; ++i ) {
+        uint64_t ready = m_ready[d.srcs[i]];
+        // Needed one cycle later
+        uint64_t late = i == d.late_src;
+        if ( d.op == OP_BRANCH && m_branch_in_id )
+            ready += 1;
+        if ( ready > at + late )
+            at = ready - late;
+    }
+
+    enum Unit u = unit( d.op );
+    if ( u != UNIT_NONE ) {
+        if ( m_unit_free[u] > at )
+            at = m_unit_free[u];
+        m_unit_free[u] = at + m_repeat[d.op];
+    }
+
+    uint32_t avail = available( d.op );
+    for ( size_t i = 0; i < d.n_dsts; ++i )
+        m_ready[d.dsts[i]] = at + avail;
+
+    uint32_t stall = at - now;
+    if ( taken )
+        stall += m_branch_penalty;
+    m_stall_cycles += stall;
+    return stall;
+}
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
@@ -0,0 +1,184 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#ifndef _SOCLIB_TRACE_REPLAY_ISS_H_
+#define _SOCLIB_TRACE_REPLAY_ISS_H_
+
+#include <string>
+#include <fstream>
+#include "iss2.h"
+#include "iss2_trace.h"
+
+namespace soclib { namespace common {
+
+/**
+ * Iss2 replaying a trace recorded by an Iss (see Iss2TraceWriter),
+ * without executing any code.
+ *
+ * The recorded instruction fetches and data accesses are issued to
+ * the wrapper with the pipeline behaviour of Mips32Iss: the data
+ * access of an instruction is issued together with the fetch of the
+ * next one, and an instruction retires (in one cycle) only when both
+ * its fetch and the previous data access are completed. Cycles spent
+ * waiting for responses are stalls, so the replay time depends on
+ * the cache and interconnect under test. Core-internal latencies
+ * (multiplier, load-use hazards) are not part of the trace.
+ *
+ * The second word of a 64-bit access is issued alone once the first
+ * one completes, in a stall cycle, as Mips32Iss does.
+ *
+ * Irq lines are ignored, irq handlers are part of the trace. Read
+ * data coming back is compared with the recorded one, see
+ * rdataMismatches().
+ *
+ * Debug registers follow the Mips32 layout, only pc is significant.
+ */
+class TraceReplayIss
+    : public Iss2
+{
+public:
+    static const int n_irq = 6;
+    static const Iss2::debugCpuEndianness s_endianness = Iss2::ISS_LITTLE_ENDIAN;
+    static const unsigned int s_sp_register_no = 29;
+    static const unsigned int s_fp_register_no = 30;
+    static const unsigned int s_pc_register_no = 37;
+
+    /**
+     * Replays the file named after setTracePattern() and `ident',
+     * as cache wrappers only give these two arguments.
+     */
+    TraceReplayIss( const std::string &name, uint32_t ident );
+
+    /**
+     * Replays from `trace', which must outlive the Iss.
+     */
+    TraceReplayIss( const std::string &name, uint32_t ident,
+                    std::istream &trace );
+
+    ~TraceReplayIss();
+
+    /**
+     * printf-like pattern of the trace file name, with one integer
+     * conversion for the ident, defaults to "trace-%d.bin".
+     */
+    static void setTracePattern( const std::string &pattern );
+
+    void reset();
+    uint32_t executeNCycles( uint32_t ncycle,
+                             const struct InstructionResponse &irsp,
+                             const struct DataResponse &drsp,
+                             uint32_t irq_bit_field );
+    uint32_t nextEventDelay( uint32_t irq_bit_field ) const;
+
+    inline void getRequests( struct InstructionRequest &ireq,
+                             struct DataRequest &dreq ) const
+    {
+        ireq.valid = m_fetching && ! m_ireq_ok;
+        ireq.addr = m_rec.pc;
+        ireq.mode = m_rec.mode;
+        dreq = m_dreq;
+    }
+
+    void setWriteBerr();
+
+    unsigned int debugGetRegisterCount() const;
+    debug_register_t debugGetRegisterValue(unsigned int reg) const;
+    void debugSetRegisterValue(unsigned int reg, debug_register_t value);
+    size_t debugGetRegisterSize(unsigned int reg) const;
+
+    // CDB method's
+#ifdef CDB_COMPONENT_IF_H
+    const char* local_GetModel();
+    int local_PrintResource(modelResource *res, char **p);
+    int local_TestResource(modelResource *res, char **p);
+    int local_Resource(char** args);
+#endif
+
+    /**
+     * The whole trace is replayed, and the last access completed.
+     */
+    inline bool ended() const
+    {
+        return ! m_fetching && ! m_dreq.valid;
+    }
+
+    inline uint64_t retired() const
+    {
+        return m_retired;
+    }
+
+    inline uint64_t stallCycles() const
+    {
+        return m_stall_cycles;
+    }
+
+    inline uint64_t rdataMismatches() const
+    {
+        return m_rdata_mismatches;
+    }
+
+private:
+    static std::string s_trace_pattern;
+
+    std::ifstream *m_file;
+    std::istream &m_in;
+    std::streampos m_start;
+    Iss2TraceReader *m_reader;
+
+    // Instruction being fetched
+    Iss2TraceReader::Record m_rec;
+    bool m_fetching;
+    bool m_ireq_ok;
+
+    // Data access of the last retired instruction
+    struct DataRequest m_dreq;
+    bool m_check_rdata;
+    data_t m_rdata;
+
+    uint64_t m_retired;
+    uint64_t m_stall_cycles;
+    uint64_t m_rdata_mismatches;
+
+    static std::istream &openTrace( std::ifstream *&file, uint32_t ident );
+    void fetchNext();
+};
+
+}}
+
+#endif // _SOCLIB_TRACE_REPLAY_ISS_H_
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4
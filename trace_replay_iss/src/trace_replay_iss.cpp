@@ -0,0 +1,218 @@
+/* -*- c++ -*-
+ *
+ * SOCLIB_LGPL_HEADER_BEGIN
+ * 
+ * This file is part of SoCLib, GNU LGPLv2.1.
+ * 
+ * SoCLib is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 of the License.
+ * 
+ * SoCLib is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with SoCLib; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * SOCLIB_LGPL_HEADER_END
+ *
+ * Copyright (c) UPMC, Lip6
+ *         Nicolas Pouillon <nipo@ssji.net>, 2008
+ *
+ * Maintainers: nipo
+ *
+ * $Id$
+ */
+
+#include "trace_replay_iss.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace soclib { namespace common {
+
+std::string TraceReplayIss::s_trace_pattern = "trace-%d.bin";
+
+void TraceReplayIss::setTracePattern( const std::string &pattern )
+{
+    s_trace_pattern = pattern;
+}
+
+std::istream &TraceReplayIss::openTrace( std::ifstream *&file, uint32_t ident )
+{
+    char path[1024];
+    snprintf(path, sizeof(path), s_trace_pattern.c_str(), ident);
+    file = new std::ifstream(path, std::ios::in | std::ios::binary);
+    return *file;
+}
+
+TraceReplayIss::TraceReplayIss( const std::string &name, uint32_t ident )
+    : Iss2(name, ident),
+      m_file(NULL),
+      m_in(openTrace(m_file, ident)),
+      m_reader(NULL)
+{
+    m_start = m_in.tellg();
+    reset();
+}
+
+TraceReplayIss::TraceReplayIss( const std::string &name, uint32_t ident,
+                                std::istream &trace )
+    : Iss2(name, ident),
+      m_file(NULL),
+      m_in(trace),
+      m_reader(NULL)
+{
+    m_start = m_in.tellg();
+    reset();
+}
+
+TraceReplayIss::~TraceReplayIss()
+{
+    delete m_reader;
+    delete m_file;
+}
+
+void TraceReplayIss::reset()
+{
+    // Rewind if possible, a non-seekable trace goes on
+    if ( m_start != std::streampos(-1) ) {
+        m_in.clear();
+        m_in.seekg(m_start);
+    }
+    delete m_reader;
+    m_reader = new Iss2TraceReader(m_in);
+    if ( ! m_reader->good() )
+        std::cerr << name() << " invalid or missing trace" << std::endl;
+
+    m_dreq.valid = false;
+    m_check_rdata = false;
+    m_rdata = 0;
+    m_retired = 0;
+    m_stall_cycles = 0;
+    m_rdata_mismatches = 0;
+    fetchNext();
+}
+
+void TraceReplayIss::fetchNext()
+{
+    m_fetching = m_reader->next( m_rec );
+    // Second word of a 64-bit access is not fetched
+    m_ireq_ok = m_fetching && m_rec.pair;
+    if ( ! m_fetching && ! m_reader->good() )
+        std::cerr << name() << " truncated trace after "
+                  << m_retired << " instructions" << std::endl;
+}
+
+uint32_t TraceReplayIss::executeNCycles(
+    uint32_t ncycle,
+    const struct InstructionResponse &irsp,
+    const struct DataResponse &drsp,
+    uint32_t irq_bit_field )
+{
+#ifdef SOCLIB_MODULE_DEBUG
+    std::cout << name() << " executeNCycles( " << ncycle << ", "<< irsp << ", " << drsp << ", " << irq_bit_field << ")" << std::endl;
+#endif
+
+    if ( m_dreq.valid && drsp.valid ) {
+        m_dreq.valid = false;
+        if ( m_check_rdata && ! drsp.error && drsp.rdata != m_rdata )
+            m_rdata_mismatches++;
+    }
+    if ( m_fetching && irsp.valid )
+        m_ireq_ok = true;
+
+    if ( ! m_fetching || ! m_ireq_ok || m_dreq.valid ) {
+        if ( m_fetching || m_dreq.valid )
+            m_stall_cycles += ncycle;
+        return ncycle;
+    }
+
+    // Retire the fetched instruction, issuing its data access
+    m_dreq = m_rec.req;
+    m_check_rdata = m_rec.req.valid && ! m_rec.error
+        && m_rec.req.type != XTN_READ && m_rec.req.type != XTN_WRITE
+        && m_rec.req.type != DATA_WRITE;
+    m_rdata = m_rec.rdata;
+    if ( m_rec.pair )
+        m_stall_cycles++;
+    else
+        m_retired++;
+    fetchNext();
+    return 1;
+}
+
+uint32_t TraceReplayIss::nextEventDelay( uint32_t irq_bit_field ) const
+{
+    return ended() ? NO_EVENT : 0;
+}
+
+void TraceReplayIss::setWriteBerr()
+{
+}
+
+unsigned int TraceReplayIss::debugGetRegisterCount() const
+{
+    return 32 + 6;
+}
+
+Iss2::debug_register_t TraceReplayIss::debugGetRegisterValue(unsigned int reg) const
+{
+    if ( reg == s_pc_register_no )
+        return m_rec.pc;
+    return 0;
+}
+
+void TraceReplayIss::debugSetRegisterValue(unsigned int reg, debug_register_t value)
+{
+}
+
+size_t TraceReplayIss::debugGetRegisterSize(unsigned int reg) const
+{
+    return 32;
+}
+
+// CDB
+#ifdef CDB_COMPONENT_IF_H
+const char *TraceReplayIss::local_GetModel()
+{
+    return("TRACE_REPLAY");
+}
+
+int TraceReplayIss::local_PrintResource(modelResource *res,char **p)
+{
+    std::cout << " $pc = 0x" << std::hex << m_rec.pc << std::endl;
+    return 0;
+}
+
+int TraceReplayIss::local_TestResource(modelResource *res,char **p)
+{
+    if (*p[1] == '$' && !strcasecmp(p[1] + 1, "pc")) {
+        res->addr = (int*)&m_rec.pc;
+        return 0;
+    }
+    fprintf(stderr, "unknown ressource %s\n", p[1]);
+    return -1;
+}
+
+int TraceReplayIss::local_Resource(char **args)
+{
+    fprintf(stdout, "p/t\t[int]\t$pc\t\t: Prints PC value\n");
+    return 0;
+}
+#endif
+
+}}
+
+// Local Variables:
+// tab-width: 4
+// c-basic-offset: 4
+// c-file-offsets:((innamespace . 0)(inline-open . 0))
+// indent-tabs-mode: nil
+// End:
+
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=4:softtabstop=4